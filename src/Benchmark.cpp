@@ -0,0 +1,698 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Benchmark.h"
+#include "Simulation.h"
+#include "HaloExchange.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "CDF.h"
+#include "Random.h"
+
+/**
+ * Helper function to split a comma separated argument into its values
+ * @param argument the comma separated values
+ * @return the values
+ */
+std::vector<std::string> splitList(std::string argument) {
+    std::vector<std::string> values;
+    std::stringstream stream(argument);
+    std::string value;
+    while (std::getline(stream, value, ',')) {
+        if (!value.empty()) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+/**
+ * Helper function to parse the values of a comma separated argument into whole numbers
+ * @param values the values of the argument
+ * @param numbers_ptr pointer to the list to replace with the numbers
+ * @return whether all the values are whole numbers
+ */
+bool parseList(std::vector<std::string> values, std::vector<int>* numbers_ptr) {
+    numbers_ptr->clear();
+    for (std::string value : values) {
+        int number;
+        if (!Inputs::parseNumber(value, &number)) {
+            return false;
+        }
+        numbers_ptr->push_back(number);
+    }
+    return true;
+}
+
+/**
+ * Helper function to parse the values of a comma separated argument into numbers
+ * @param values the values of the argument
+ * @param numbers_ptr pointer to the list to replace with the numbers
+ * @return whether all the values are numbers
+ */
+bool parseList(std::vector<std::string> values, std::vector<double>* numbers_ptr) {
+    numbers_ptr->clear();
+    for (std::string value : values) {
+        double number;
+        if (!Inputs::parseNumber(value, &number)) {
+            return false;
+        }
+        numbers_ptr->push_back(number);
+    }
+    return true;
+}
+
+/**
+ * Constructor for the Benchmark, with the default matrix of configurations
+ * @param inputs instance of the Inputs class with the parameters of the Vehicles that are used by all the runs
+ */
+Benchmark::Benchmark(Inputs inputs) {
+    this->inputs = inputs;
+
+    // Run on 1, 2, 4, ... processes up to all of them
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    for (int num_ranks = 1; num_ranks < size; num_ranks *= 2) {
+        this->ranks.push_back(num_ranks);
+    }
+    this->ranks.push_back(size);
+
+    this->lengths = {100000};
+    this->densities = {10.0, 30.0};
+    this->lanes = {inputs.num_lanes};
+    this->engines = {"sequential", "synchronous"};
+    this->roads = {"ring", "open"};
+    this->mode = "scaling";
+    this->steps = 200;
+    this->interval = 4;
+}
+
+/**
+ * Prints an error in the benchmark options on the first process, every process finds the same errors
+ * @param message the error message
+ * @return 1, the status of the failed parsing
+ */
+int Benchmark::reportError(std::string message) {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (world_rank == 0) {
+        std::cout << "error: " << message << "!" << std::endl;
+    }
+    return 1;
+}
+
+/**
+ * Parses the command line arguments that replace the default matrix of configurations. The lists are comma
+ * separated, for example --ranks 1,2,4.
+ * @param argc number of command line arguments
+ * @param argv command line arguments
+ * @return 0 if successful, nonzero otherwise
+ */
+int Benchmark::parseArguments(int argc, char** argv) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    bool engines_given = false;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            return this->reportError("missing value for the benchmark option " + option);
+        }
+        std::vector<std::string> values = splitList(argv[++i]);
+        if (values.empty()) {
+            return this->reportError("empty value for the benchmark option " + option);
+        }
+
+        bool valid = true;
+        if (option == "--lengths") {
+            valid = parseList(values, &(this->lengths));
+        } else if (option == "--densities") {
+            valid = parseList(values, &(this->densities));
+        } else if (option == "--ranks") {
+            valid = parseList(values, &(this->ranks));
+        } else if (option == "--lanes") {
+            valid = parseList(values, &(this->lanes));
+        } else if (option == "--engines") {
+            this->engines = values;
+            engines_given = true;
+        } else if (option == "--roads") {
+            this->roads = values;
+        } else if (option == "--mode") {
+            this->mode = values[0];
+        } else if (option == "--steps") {
+            valid = Inputs::parseNumber(values[0], &(this->steps));
+        } else if (option == "--interval") {
+            valid = Inputs::parseNumber(values[0], &(this->interval));
+        } else if (option == "--output") {
+            this->output_path = values[0];
+        } else {
+            return this->reportError("unknown benchmark option " + option);
+        }
+        if (!valid) {
+            return this->reportError("invalid value " + std::string(argv[i]) + " for the benchmark option " + option);
+        }
+    }
+
+    // The validation runs every engine unless the engines are given
+    if (this->mode != "scaling" && this->mode != "validate" && this->mode != "micro") {
+        return this->reportError("unknown benchmark mode " + this->mode);
+    }
+    if (this->mode == "validate" && !engines_given) {
+        this->engines = {"sequential", "synchronous", "local", "device"};
+    }
+    for (std::string road : this->roads) {
+        if (road != "ring" && road != "open") {
+            return this->reportError("unknown benchmark road " + road);
+        }
+    }
+
+    // The runs on fewer processes are made on a subset of the processes of the launch
+    std::sort(this->ranks.begin(), this->ranks.end());
+    if (this->ranks.front() < 1 || this->ranks.back() > size) {
+        return this->reportError("the benchmark can only run on 1 to " + std::to_string(size) + " processes");
+    }
+    for (std::string engine : this->engines) {
+        if (engine != "sequential" && engine != "synchronous" && engine != "local" && engine != "device") {
+            return this->reportError("unknown benchmark engine " + engine);
+        }
+    }
+    if (this->interval < 2) {
+        return this->reportError("the exchange interval of the local and device engines must be at least 2");
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Runs the simulation of one configuration on the first processes of the launch, the other processes skip the run
+ * @param inputs instance of the Inputs class with the configuration
+ * @param num_ranks number of processes to run on
+ * @param result pointer to the measurements of the run, set on the first process only
+ * @param digest_ptr pointer to the digest of the steps of the run, set on the processes of the run, or nullptr
+ * @return 0 if successful, nonzero otherwise
+ */
+int Benchmark::runCase(Inputs inputs, int num_ranks, BenchmarkResult* result, StateDigest* digest_ptr) {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    MPI_Comm run_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, (world_rank < num_ranks) ? 0 : MPI_UNDEFINED, world_rank, &run_comm);
+    if (run_comm == MPI_COMM_NULL) {
+        return 0;
+    }
+
+    // Arrange the processes of the run in a line, or in a ring if the Road is a ring, as the simulation does
+    MPI_Comm road_comm;
+    int dims[1] = {num_ranks};
+    int periods[1] = {inputs.periodic};
+    MPI_Cart_create(run_comm, 1, dims, periods, 0, &road_comm);
+    int rank;
+    MPI_Comm_rank(road_comm, &rank);
+    int road_length_per_process = inputs.length / num_ranks + ((rank < inputs.length % num_ranks) ? 1 : 0);
+
+    Simulation* simulation_ptr = new Simulation(inputs, road_length_per_process);
+    simulation_ptr->setDigest(digest_ptr);
+    simulation_ptr->run_simulation(road_comm);
+
+    // The run takes as long as its slowest process, and the communication time is averaged over the processes
+    double time = simulation_ptr->getElapsedTime();
+    double communication_time = simulation_ptr->getCommunicationTime();
+    double max_time;
+    double total_communication_time;
+    MPI_Reduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, road_comm);
+    MPI_Reduce(&communication_time, &total_communication_time, 1, MPI_DOUBLE, MPI_SUM, 0, road_comm);
+    if (rank == 0) {
+        result->time = max_time;
+        result->communication_time = total_communication_time / num_ranks;
+        result->num_vehicles = simulation_ptr->getNumPlaced();
+    }
+
+    delete simulation_ptr;
+    MPI_Comm_free(&road_comm);
+    MPI_Comm_free(&run_comm);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Writes the comma separated values of one run
+ * @param stream pointer to the stream to write to
+ * @param scaling the kind of scaling that the run belongs to, strong or weak
+ * @param inputs instance of the Inputs class with the configuration of the run
+ * @param num_ranks number of processes of the run
+ * @param result the measurements of the run
+ * @param efficiency scaling efficiency of the run relative to the run on the fewest processes
+ * @return 0 if successful, nonzero otherwise
+ */
+int Benchmark::writeRow(std::ostream* stream, std::string scaling, Inputs inputs, int num_ranks,
+                        BenchmarkResult result, double efficiency) {
+    std::string engine = "sequential";
+    if (inputs.synchronous) {
+        engine = (inputs.exchange_interval > 1) ? "local" : "synchronous";
+    }
+    if (inputs.device) {
+        engine = "device";
+    }
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    double time_per_step = result.time / inputs.max_time;
+    double time_per_vehicle_step = time_per_step / std::max(result.num_vehicles, 1);
+    (*stream) << scaling << "," << engine << "," << inputs.num_lanes << "," << inputs.length << ","
+              << inputs.percent_full << "," << num_ranks << "," << threads << "," << inputs.max_time << ","
+              << result.num_vehicles << "," << result.time << "," << time_per_step << ","
+              << time_per_vehicle_step * 1e9 << "," << result.communication_time / result.time << ","
+              << efficiency << std::endl;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Opens the output file on the first process, if one is given, otherwise the results are written to the standard
+ * output
+ * @param output_file pointer to the output file to open
+ * @return pointer to the stream to write the results to, or nullptr if the file can not be opened
+ */
+std::ostream* Benchmark::openOutput(std::ofstream* output_file) {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (world_rank == 0 && !this->output_path.empty()) {
+        output_file->open(this->output_path, std::ofstream::out);
+        if (!(*output_file)) {
+            std::cout << "error: failure to open \"" << this->output_path << "\" file!" << std::endl;
+            return nullptr;
+        }
+    }
+    return output_file->is_open() ? (std::ostream*) output_file : &std::cout;
+}
+
+/**
+ * Sets the inputs of an update engine
+ * @param inputs pointer to the Inputs of the run
+ * @param engine the name of the engine
+ * @return 0 if successful, nonzero otherwise
+ */
+int Benchmark::setEngine(Inputs* inputs, std::string engine) {
+    inputs->synchronous = (engine == "sequential") ? 0 : 1;
+    inputs->exchange_interval = (engine == "local" || engine == "device") ? this->interval : 1;
+    inputs->device = (engine == "device") ? 1 : 0;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Runs the matrix of configurations, on every process of the launch, and writes the results on the first process. For
+ * every configuration, the strong scaling runs keep the length of the road and the weak scaling runs grow it with the
+ * number of processes.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Benchmark::runScaling() {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    std::ofstream output_file;
+    std::ostream* stream = this->openOutput(&output_file);
+    if (stream == nullptr) {
+        return 1;
+    }
+    if (world_rank == 0) {
+        (*stream) << "scaling,engine,lanes,length,density,ranks,threads,steps,vehicles,time,time_per_step,"
+                  << "ns_per_vehicle_step,communication_fraction,efficiency" << std::endl;
+    }
+
+    for (std::string engine : this->engines) {
+        for (int num_lanes : this->lanes) {
+            for (int length : this->lengths) {
+                for (double density : this->densities) {
+                    // Set up the configuration on a ring filled to the density, with the given engine
+                    Inputs inputs = this->inputs;
+                    inputs.num_lanes = num_lanes;
+                    inputs.percent_full = density;
+                    inputs.periodic = 1;
+                    inputs.max_time = this->steps;
+                    inputs.warmup_time = 0;
+                    inputs.balance_interval = 0;
+                    inputs.checkpoint_interval = 0;
+                    inputs.restart = 0;
+                    inputs.output_interval = 0;
+                    this->setEngine(&inputs, engine);
+
+                    int base_ranks = this->ranks.front();
+                    BenchmarkResult base = {0.0, 0.0, 0};
+                    for (int num_ranks : this->ranks) {
+                        for (int weak = 0; weak < 2; weak++) {
+                            // The run on the fewest processes is the same for both kinds of scaling
+                            if (weak && num_ranks == base_ranks) {
+                                continue;
+                            }
+                            inputs.length = weak ? (int) ((long long) length * num_ranks / base_ranks) : length;
+                            if (inputs.length / num_ranks < HaloExchange::minSegmentSize(inputs)) {
+                                if (world_rank == 0) {
+                                    std::cerr << "warning: skipping " << engine << " with " << num_lanes
+                                              << " lanes on " << num_ranks << " processes, the road is too short"
+                                              << std::endl;
+                                }
+                                continue;
+                            }
+
+                            BenchmarkResult result = {0.0, 0.0, 0};
+                            this->runCase(inputs, num_ranks, &result, nullptr);
+                            if (world_rank != 0) {
+                                continue;
+                            }
+                            if (num_ranks == base_ranks) {
+                                base = result;
+                            }
+
+                            // Strong scaling divides the same work over more processes, weak scaling keeps the work
+                            // per process the same
+                            double efficiency = 0.0;
+                            if (base.time > 0.0) {
+                                efficiency = base.time / result.time;
+                                if (!weak) {
+                                    efficiency *= (double) base_ranks / num_ranks;
+                                }
+                            }
+                            if (num_ranks == base_ranks) {
+                                this->writeRow(stream, "strong", inputs, num_ranks, result, efficiency);
+                                this->writeRow(stream, "weak", inputs, num_ranks, result, efficiency);
+                            } else {
+                                this->writeRow(stream, weak ? "weak" : "strong", inputs, num_ranks, result,
+                                               efficiency);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Reads the counts of the detectors that the last run wrote on the first process, and removes their file
+ * @param inputs instance of the Inputs class with the configuration of the run
+ * @return the contents of the file of the detectors, empty on the other processes or if the run had no detectors
+ */
+std::string Benchmark::readDetectors(Inputs inputs) {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (world_rank != 0 || inputs.detector_interval == 0) {
+        return "";
+    }
+    std::string path = inputs.getPath("cats-detectors.csv");
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    file.close();
+    std::remove(path.c_str());
+    return contents.str();
+}
+
+/**
+ * Runs the matrix of configurations with a digest of every step and detectors across the Road, on every process of the
+ * launch, and writes the digests of the runs on the first process with the result of their comparison. The engines
+ * other than the sequential update are compared with the first of them, on any number of processes. The sequential
+ * update depends on the order of the Vehicles and so on the partitioning of the Road, so it is run twice on every
+ * number of processes and compared with itself. The counts of the detectors are compared in the same way, except for
+ * the device engine, which runs without detectors.
+ * @return 0 if successful, 1 if a run differs from its reference
+ */
+int Benchmark::runValidation() {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    std::ofstream output_file;
+    std::ostream* stream = this->openOutput(&output_file);
+    if (stream == nullptr) {
+        return 1;
+    }
+    if (world_rank == 0) {
+        (*stream) << "road,engine,lanes,length,density,ranks,steps,vehicle_steps,mean_speed,departures,"
+                  << "mean_travel_time,hash,reference,mismatch_step,detectors,status" << std::endl;
+    }
+
+    int num_runs = 0;
+    int num_failed = 0;
+    for (std::string road : this->roads) {
+        // The density only applies to a ring, an open Road is filled by the Vehicles that spawn at its start
+        std::vector<double> densities = (road == "ring") ? this->densities : std::vector<double>{0.0};
+        for (int num_lanes : this->lanes) {
+            for (int length : this->lengths) {
+                for (double density : densities) {
+                    Inputs inputs = this->inputs;
+                    inputs.num_lanes = num_lanes;
+                    inputs.length = length;
+                    inputs.periodic = (road == "ring") ? 1 : 0;
+                    inputs.percent_full = density;
+                    inputs.max_time = this->steps;
+                    inputs.warmup_time = 0;
+                    inputs.checkpoint_interval = 0;
+                    inputs.restart = 0;
+                    inputs.output_interval = 0;
+
+                    // The detectors are spaced so that some of them are at the boundaries between the segments
+                    inputs.detector_spacing = std::max(1, length / 8);
+
+                    StateDigest reference(inputs);
+                    std::string reference_name;
+                    std::string reference_detectors;
+                    for (std::string engine : this->engines) {
+                        this->setEngine(&inputs, engine);
+                        inputs.detector_interval = inputs.device ? 0 : Benchmark::DETECTOR_INTERVAL;
+                        if (inputs.device && !inputs.periodic) {
+                            if (world_rank == 0) {
+                                std::cerr << "warning: skipping device on an open road, it only runs on a ring"
+                                          << std::endl;
+                            }
+                            continue;
+                        }
+                        for (int num_ranks : this->ranks) {
+                            if (inputs.length / num_ranks < HaloExchange::minSegmentSize(inputs)) {
+                                if (world_rank == 0) {
+                                    std::cerr << "warning: skipping " << engine << " with " << num_lanes
+                                              << " lanes on " << num_ranks << " processes, the road is too short"
+                                              << std::endl;
+                                }
+                                continue;
+                            }
+                            std::string name = engine + " on " + std::to_string(num_ranks);
+                            StateDigest first(inputs);
+                            std::string first_detectors;
+                            int num_repeats = (engine == "sequential") ? 2 : 1;
+                            for (int repeat = 0; repeat < num_repeats; repeat++) {
+                                StateDigest digest(inputs);
+                                BenchmarkResult result = {0.0, 0.0, 0};
+                                this->runCase(inputs, num_ranks, &result, &digest);
+                                std::string detectors = this->readDetectors(inputs);
+                                if (world_rank != 0) {
+                                    continue;
+                                }
+
+                                // Compare the run with the first run of the sequential update on the same
+                                // processes, or with the first run of the other engines
+                                StateDigest* reference_ptr = nullptr;
+                                std::string* detectors_ptr = nullptr;
+                                std::string compared_to;
+                                if (engine == "sequential") {
+                                    if (repeat == 0) {
+                                        first = digest;
+                                        first_detectors = detectors;
+                                    } else {
+                                        reference_ptr = &first;
+                                        detectors_ptr = &first_detectors;
+                                        compared_to = name;
+                                    }
+                                } else if (reference_name.empty()) {
+                                    reference = digest;
+                                    reference_name = name;
+                                } else {
+                                    reference_ptr = &reference;
+                                    compared_to = reference_name;
+                                }
+
+                                // The detectors of the other engines are compared with the first run that has them
+                                if (engine != "sequential" && inputs.detector_interval > 0) {
+                                    if (reference_detectors.empty()) {
+                                        reference_detectors = detectors;
+                                    } else {
+                                        detectors_ptr = &reference_detectors;
+                                    }
+                                }
+                                int mismatch = (reference_ptr != nullptr) ? digest.findMismatch(reference_ptr) : -1;
+                                std::string detectors_status = (inputs.detector_interval > 0) ? "reference" : "none";
+                                if (detectors_ptr != nullptr) {
+                                    detectors_status = (detectors == *detectors_ptr) ? "match" : "mismatch";
+                                }
+                                bool failed = (mismatch >= 0 || detectors_status == "mismatch");
+                                std::string status = "reference";
+                                if (reference_ptr != nullptr || detectors_ptr != nullptr) {
+                                    status = failed ? "mismatch" : "match";
+                                }
+                                num_runs++;
+                                num_failed += failed ? 1 : 0;
+
+                                long long vehicle_steps = digest.getTotal(StateDigest::VEHICLE_STEPS);
+                                long long departures = digest.getTotal(StateDigest::NUM_LEFT);
+                                double mean_speed = (double) digest.getTotal(StateDigest::SPEED_SUM) /
+                                    std::max(vehicle_steps, 1LL);
+                                double mean_travel_time = (double) digest.getTotal(StateDigest::TRAVEL_SUM) /
+                                    std::max(departures, 1LL);
+                                (*stream) << road << "," << engine << "," << num_lanes << "," << length << ","
+                                          << density << "," << num_ranks << "," << this->steps << ","
+                                          << vehicle_steps << "," << mean_speed << "," << departures << ","
+                                          << mean_travel_time << "," << std::hex << std::setw(16)
+                                          << std::setfill('0') << digest.getFinalHash() << std::dec
+                                          << std::setfill(' ') << "," << compared_to << "," << mismatch << ","
+                                          << detectors_status << "," << status << std::endl;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Every process returns the same status
+    MPI_Bcast(&num_failed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (world_rank == 0) {
+        std::cerr << "validation: " << num_failed << " of " << num_runs << " runs differ from their reference"
+                  << std::endl;
+    }
+
+    return (num_failed > 0) ? 1 : 0;
+}
+
+/**
+ * Times the gap updates and the moves of the Vehicles on a segment filled to every density, and the samplers of the
+ * CDF of interarrival times, on the first process of the launch, and writes the time per call. The Vehicles are only
+ * placed in the sites that they can not leave during the steps, so the same Vehicles are moved in every step.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Benchmark::runMicro() {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (world_rank != 0) {
+        return 0;
+    }
+
+    std::ofstream output_file;
+    std::ostream* stream = this->openOutput(&output_file);
+    if (stream == nullptr) {
+        return 1;
+    }
+    (*stream) << "kernel,lanes,length,density,calls,time,ns_per_call" << std::endl;
+
+    for (int num_lanes : this->lanes) {
+        for (int length : this->lengths) {
+            for (double density : this->densities) {
+                Inputs inputs = this->inputs;
+                inputs.num_lanes = num_lanes;
+                inputs.length = length;
+                inputs.exchange_interval = 1;
+                Road road(inputs, length);
+                std::vector<Vehicle*> vehicles;
+                double fill = density / 100.0;
+                int fill_end = std::max(length - this->steps * inputs.max_speed, 0);
+                for (int i = 0; i < num_lanes; i++) {
+                    for (int site = 0; site < fill_end; site++) {
+                        if (std::floor((site + 1) * fill) > std::floor(site * fill)) {
+                            vehicles.push_back(road.getVehiclePool()->acquire(i, i * length + site, site, 0));
+                            road.getLane(i)->addVehicle(site);
+                        }
+                    }
+                }
+
+                // Time the gap updates and the moves separately, the moves use the gaps of the same step
+                double gaps_time = 0.0;
+                double move_time = 0.0;
+                for (int step = 0; step < this->steps; step++) {
+                    road.getRandom()->setStep(step);
+                    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                    for (Vehicle* vehicle_ptr : vehicles) {
+                        vehicle_ptr->updateGaps(&road);
+                    }
+                    std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+                    for (Vehicle* vehicle_ptr : vehicles) {
+                        vehicle_ptr->performLaneMove(&road);
+                    }
+                    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                    gaps_time += std::chrono::duration<double>(middle - begin).count();
+                    move_time += std::chrono::duration<double>(end - middle).count();
+                }
+                long long calls = (long long) vehicles.size() * this->steps;
+                (*stream) << "updateGaps," << num_lanes << "," << length << "," << density << "," << calls << ","
+                          << gaps_time << "," << gaps_time / std::max(calls, 1LL) * 1e9 << std::endl;
+                (*stream) << "performLaneMove," << num_lanes << "," << length << "," << density << "," << calls
+                          << "," << move_time << "," << move_time / std::max(calls, 1LL) * 1e9 << std::endl;
+            }
+        }
+    }
+
+    // Time every sampler of the CDF with the same uniform random numbers
+    static const char* sampler_names[3] = {"binary_search", "inverse_table", "alias_table"};
+    Random random(this->inputs.seed);
+    std::vector<double> uniforms(65536);
+    for (int n = 0; n < (int) uniforms.size(); n++) {
+        uniforms[n] = random.uniform(Random::SPAWN_INTERVAL, n);
+    }
+    for (int sampler = CDF::BINARY_SEARCH; sampler <= CDF::ALIAS_TABLE; sampler++) {
+        CDF cdf;
+        if (cdf.setTable(this->inputs.cdf_x, this->inputs.cdf_values) != 0 || cdf.setSampler(sampler) != 0) {
+            return 1;
+        }
+        double sum = 0.0;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (int step = 0; step < this->steps; step++) {
+            for (double uniform : uniforms) {
+                sum += cdf.query(uniform);
+            }
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        double time = std::chrono::duration<double>(end - begin).count();
+        long long calls = (long long) uniforms.size() * this->steps;
+
+        // The sum of the samples is kept so that the queries are not optimized out
+        volatile double samples_sum = sum;
+        (void) samples_sum;
+        (*stream) << "CDF::query/" << sampler_names[sampler] << ",,,," << calls << "," << time << ","
+                  << time / calls * 1e9 << std::endl;
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Runs the benchmark in the mode given on the command line
+ * @return 0 if successful, nonzero otherwise
+ */
+int Benchmark::run() {
+    if (this->mode == "validate") {
+        return this->runValidation();
+    }
+    if (this->mode == "micro") {
+        return this->runMicro();
+    }
+    return this->runScaling();
+}
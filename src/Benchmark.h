@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_BENCHMARK_H
+#define CA_TRAFFIC_SIMULATION_BENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <mpi.h>
+
+#include "Inputs.h"
+#include "StateDigest.h"
+
+/**
+ * Structure for the measurements of one benchmark run, combined across the processes of the run
+ */
+struct BenchmarkResult {
+    double time;
+    double communication_time;
+    int num_vehicles;
+};
+
+/**
+ * Class for the benchmark suite of the simulation. Runs a matrix of configurations of the road length, the density,
+ * the number of processes, the number of Lanes and the update engine on a ring, so that the number of Vehicles stays
+ * fixed, and reports the time per step per Vehicle, the fraction of the time spent communicating and the strong and
+ * weak scaling efficiencies relative to the smallest number of processes as comma separated values. All the runs are
+ * made in a single launch of the program, with the runs on fewer processes made on a subset of the processes.
+ * In the validation mode, the same matrix is run with a digest of every step and detectors instead, on rings and on
+ * open Roads, and the runs of the engines that do not depend on the partitioning of the Road have to match the first
+ * of them on any number of processes to the last bit, along with the counts of their detectors, while the sequential
+ * update has to match itself on the same processes. The micro mode times the gap updates, the moves of the Vehicles
+ * and the samplers of the CDF on one process.
+ */
+class Benchmark {
+private:
+    Inputs inputs;
+    std::vector<int> lengths;
+    std::vector<double> densities;
+    std::vector<int> ranks;
+    std::vector<int> lanes;
+    std::vector<std::string> engines;
+    std::vector<std::string> roads;
+    std::string mode;
+    int steps;
+    int interval;
+    std::string output_path;
+    int reportError(std::string message);
+    std::ostream* openOutput(std::ofstream* output_file);
+    int setEngine(Inputs* inputs, std::string engine);
+    int runCase(Inputs inputs, int num_ranks, BenchmarkResult* result, StateDigest* digest_ptr);
+    std::string readDetectors(Inputs inputs);
+    int writeRow(std::ostream* stream, std::string scaling, Inputs inputs, int num_ranks, BenchmarkResult result,
+                 double efficiency);
+public:
+    static constexpr int DETECTOR_INTERVAL = 7;
+
+    Benchmark(Inputs inputs);
+    int parseArguments(int argc, char** argv);
+    int runScaling();
+    int runValidation();
+    int runMicro();
+    int run();
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_BENCHMARK_H
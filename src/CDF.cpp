@@ -7,6 +7,14 @@
 #include <fstream>
 #include <string>
 #include <iostream>
+#include <algorithm>
+
+/**
+ * Constructor for the CDF, which samples with a binary search until another sampler is set
+ */
+CDF::CDF() {
+    this->sampler = CDF::BINARY_SEARCH;
+}
 
 /**
  * Reads the data for the cumulative distribution function from a two column comma delimited text file where the first
@@ -28,27 +36,196 @@ int CDF::read_cdf(std::string file_name) {
     std::string line;
     while (std::getline(file, line))
     {
+        if (line.find(',') == std::string::npos) {
+            continue;
+        }
         this->x.push_back(std::stod(line.substr(0, line.find(','))));
-        this->cdf.push_back(std::stod(line.substr(1, line.find(','))));
+        this->cdf.push_back(std::stod(line.substr(line.find(',') + 1)));
     }
 
     // Close the file
     file.close();
 
+    // Check that the CDF has at least one value
+    if (this->x.empty()) {
+        std::cout << "error: no values in " << file_name << " file!" << std::endl;
+        return 1;
+    }
+
     // Return with no errors
     return 0;
 }
 
 /**
- * Sampled a point from the cumulative distribution function
- * @return sampled point from the distribution
+ * Copies the tabulated values and the distribution function at the values out of the CDF
+ * @param x pointer to the list to copy the values to
+ * @param cdf pointer to the list to copy the distribution function at the values to
+ * @return 0 if successful, nonzero otherwise
+ */
+int CDF::getTable(std::vector<float>* x, std::vector<float>* cdf) {
+    *x = this->x;
+    *cdf = this->cdf;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Sets the tabulated values and the distribution function at the values, as read by read_cdf on another process
+ * @param x the values in ascending order
+ * @param cdf the distribution function at the values
+ * @return 0 if successful, nonzero otherwise
+ */
+int CDF::setTable(std::vector<float> x, std::vector<float> cdf) {
+    if (x.empty() || x.size() != cdf.size()) {
+        std::cout << "error: the CDF needs the same number of values and probabilities!" << std::endl;
+        return 1;
+    }
+    this->x = x;
+    this->cdf = cdf;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Sets the sampler for drawing points from the distribution and builds its tables
+ * @param sampler one of the Samplers of the CDF
+ * @return 0 if successful, nonzero otherwise
+ */
+int CDF::setSampler(int sampler) {
+    this->sampler = sampler;
+    if (sampler == CDF::INVERSE_TABLE) {
+        return this->buildInverseTable();
+    } else if (sampler == CDF::ALIAS_TABLE) {
+        return this->buildAliasTable();
+    } else if (sampler != CDF::BINARY_SEARCH) {
+        std::cout << "error: unknown CDF sampler " << sampler << "!" << std::endl;
+        return 1;
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Computes the inverse of the CDF interpolated linearly between the tabulated values. Below the first tabulated
+ * probability the first value is returned, and above the last tabulated probability the last value.
+ * @param u probability in [0, 1]
+ * @return the value at which the interpolated CDF reaches the probability
  */
-double CDF::query() {
-    double u = ((double) std::rand()) / ((double) RAND_MAX);
-    for (int i = 0; i < (int) this->cdf.size(); i++) {
-        if (this->cdf[i] >= u) {
-            return this->x[i];
+double CDF::interpolateInverse(double u) {
+    int i = std::lower_bound(this->cdf.begin(), this->cdf.end(), u) - this->cdf.begin();
+    if (i == 0) {
+        return this->x.front();
+    }
+    if (i == (int) this->cdf.size()) {
+        return this->x.back();
+    }
+    double width = this->cdf[i] - this->cdf[i - 1];
+    if (width <= 0.0) {
+        return this->x[i];
+    }
+    return this->x[i - 1] + (u - this->cdf[i - 1]) / width * (this->x[i] - this->x[i - 1]);
+}
+
+/**
+ * Builds the lookup table of the interpolated inverse of the CDF at equally spaced probabilities, with several entries
+ * per tabulated value so that the interpolation between the entries follows the interpolated CDF closely
+ * @return 0 if successful, nonzero otherwise
+ */
+int CDF::buildInverseTable() {
+    int num_entries = std::max(4096, 4 * (int) this->cdf.size());
+    this->inverse_table.resize(num_entries + 1);
+    for (int k = 0; k <= num_entries; k++) {
+        this->inverse_table[k] = this->interpolateInverse((double) k / num_entries);
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Builds the Walker alias table of the tabulated values, with Vose's method. The probability of each value is the
+ * increase of the CDF at the value, and the probability above the last tabulated probability goes to the last value.
+ * @return 0 if successful, nonzero otherwise
+ */
+int CDF::buildAliasTable() {
+    int n = this->x.size();
+    std::vector<double> scaled(n);
+    double previous = 0.0;
+    for (int i = 0; i < n; i++) {
+        scaled[i] = std::max(0.0, this->cdf[i] - previous) * n;
+        previous = std::max(previous, (double) this->cdf[i]);
+    }
+    scaled[n - 1] += std::max(0.0, 1.0 - previous) * n;
+
+    // Pair every value with less than the average probability with one that has more
+    this->alias_prob.assign(n, 1.0);
+    this->alias_index.resize(n);
+    std::vector<int> small;
+    std::vector<int> large;
+    for (int i = 0; i < n; i++) {
+        this->alias_index[i] = i;
+        if (scaled[i] < 1.0) {
+            small.push_back(i);
+        } else {
+            large.push_back(i);
+        }
+    }
+    while (!small.empty() && !large.empty()) {
+        int s = small.back();
+        small.pop_back();
+        int l = large.back();
+        this->alias_prob[s] = scaled[s];
+        this->alias_index[s] = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
         }
     }
-    return this->cdf.back();
-}
\ No newline at end of file
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Samples a point from the cumulative distribution function
+ * @param u uniformly distributed random number in [0, 1)
+ * @return sampled point from the distribution
+ */
+double CDF::query(double u) {
+    if (this->sampler == CDF::INVERSE_TABLE) {
+        double scaled = u * (this->inverse_table.size() - 1);
+        int k = (int) scaled;
+        return this->inverse_table[k] + (scaled - k) * (this->inverse_table[k + 1] - this->inverse_table[k]);
+    } else if (this->sampler == CDF::ALIAS_TABLE) {
+        double scaled = u * this->x.size();
+        int i = (int) scaled;
+        return (scaled - i < this->alias_prob[i]) ? this->x[i] : this->x[this->alias_index[i]];
+    }
+
+    // Find the first tabulated probability that is at least u
+    int i = std::lower_bound(this->cdf.begin(), this->cdf.end(), u) - this->cdf.begin();
+    if (i < (int) this->cdf.size()) {
+        return this->x[i];
+    }
+    return this->x.back();
+}
+
+/**
+ * Samples several points from the cumulative distribution function at once
+ * @param n number of points to sample
+ * @param u pointer to n uniformly distributed random numbers in [0, 1)
+ * @param samples pointer to the n sampled points
+ * @return 0 if successful, nonzero otherwise
+ */
+int CDF::sample(int n, const double* u, double* samples) {
+    for (int k = 0; k < n; k++) {
+        samples[k] = this->query(u[k]);
+    }
+
+    // Return with no errors
+    return 0;
+}
@@ -9,15 +9,41 @@
 #include <string>
 
 /**
- * Class for a Cumulative Distribution Function that has a method for sampling a point from the distribution.
+ * Class for a Cumulative Distribution Function that has methods for sampling points from the distribution. The points
+ * are sampled with one of several samplers, which are set up once after the CDF is read:
+ *  - a binary search of the tabulated values, which samples the tabulated values as a discrete distribution,
+ *  - a lookup table of the inverse of the CDF interpolated linearly between the tabulated values, which samples from
+ *    the continuous distribution and takes the same time for any number of tabulated values,
+ *  - a Walker alias table, which samples the tabulated values as a discrete distribution in constant time.
  */
 class CDF {
 private:
     std::vector<float> x;
     std::vector<float> cdf;
+    int sampler;
+    std::vector<double> inverse_table;
+    std::vector<double> alias_prob;
+    std::vector<int> alias_index;
+    double interpolateInverse(double u);
+    int buildInverseTable();
+    int buildAliasTable();
 public:
+    /**
+     * Samplers for drawing points from the distribution
+     */
+    enum Sampler {
+        BINARY_SEARCH = 0,
+        INVERSE_TABLE = 1,
+        ALIAS_TABLE = 2
+    };
+
+    CDF();
     int read_cdf(std::string file_name);
-    double query();
+    int getTable(std::vector<float>* x, std::vector<float>* cdf);
+    int setTable(std::vector<float> x, std::vector<float> cdf);
+    int setSampler(int sampler);
+    double query(double u);
+    int sample(int n, const double* u, double* samples);
 };
 
 
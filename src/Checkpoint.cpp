@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include "Checkpoint.h"
+#include "Lane.h"
+
+/**
+ * Constructor for the Checkpoint
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @param comm Cartesian communicator of the segments of the Road
+ */
+Checkpoint::Checkpoint(Inputs inputs, MPI_Comm comm) {
+    this->comm = comm;
+    this->inputs = inputs;
+    MPI_Comm_rank(comm, &(this->rank));
+    MPI_Comm_size(comm, &(this->size));
+    HaloExchange::createVehicleType(&(this->vehicle_type));
+}
+
+/**
+ * Destructor for the Checkpoint
+ */
+Checkpoint::~Checkpoint() {
+    MPI_Type_free(&(this->vehicle_type));
+}
+
+/**
+ * Writes the state of the simulation to a checkpoint file, with collective writes of all the processes. The file is
+ * written under a temporary name and renamed when it is complete, so that an interrupted write leaves the previous
+ * checkpoint intact. No exchange can be in flight, and only the Vehicles inside the segment are written, the ghost
+ * Vehicles are written by the processes that own them.
+ * @param path path of the checkpoint file
+ * @param state the state of the simulation outside the Road
+ * @param segment_start the site of the Road at the start of the segment
+ * @param road_ptr pointer to the Road of the segment
+ * @param vehicles pointer to the list of Vehicles in the segment
+ * @param travel_time pointer to the travel time Statistic of the process
+ * @param speed pointer to the speed Statistic of the process
+ * @return 0 if successful, nonzero otherwise
+ */
+int Checkpoint::write(std::string path, CheckpointState state, int segment_start, Road* road_ptr,
+                      std::vector<Vehicle*>* vehicles, Statistic* travel_time, Statistic* speed) {
+    // Collect the Vehicles of the segment with their positions on the whole Road, a segment may wrap around the end
+    // of a ring
+    int segment_size = road_ptr->getLane(0)->getSize();
+    std::vector<VehicleData> records;
+    records.reserve(vehicles->size());
+    for (Vehicle* vehicle_ptr : *vehicles) {
+        int position = vehicle_ptr->getPrevPosition();
+        if (position >= 0 && position < segment_size) {
+            records.push_back({
+                vehicle_ptr->getVehicleLane(),
+                vehicle_ptr->getId(),
+                (segment_start + position) % this->inputs.length,
+                vehicle_ptr->getSpeed(),
+                vehicle_ptr->getTimeOnRoad(),
+                vehicle_ptr->getVehicleClass()
+            });
+        }
+    }
+
+    // Locate the Vehicles of the segment in the list of the Vehicles of all the segments
+    CheckpointSegment segment = {0, (long long) records.size(), segment_start, segment_size};
+    long long num_vehicles = 0;
+    MPI_Exscan(&(segment.num_vehicles), &(segment.first_vehicle), 1, MPI_LONG_LONG, MPI_SUM, this->comm);
+    if (this->rank == 0) {
+        segment.first_vehicle = 0;
+    }
+    MPI_Allreduce(&(segment.num_vehicles), &num_vehicles, 1, MPI_LONG_LONG, MPI_SUM, this->comm);
+
+    // Combine the Statistics of all the processes, without changing the Statistics that the processes keep adding to
+    Statistic combined_travel_time = *travel_time;
+    Statistic combined_speed = *speed;
+    combined_travel_time.reduce(0, this->comm);
+    combined_speed.reduce(0, this->comm);
+
+    // The first process writes the header, the times to the next spawn and the Statistics
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "CATSCKPT", 8);
+    header.num_vehicles = num_vehicles;
+    header.version = Checkpoint::VERSION;
+    header.num_lanes = this->inputs.num_lanes;
+    header.length = this->inputs.length;
+    header.periodic = this->inputs.periodic;
+    header.time = state.time;
+    header.next_id = state.next_id;
+    header.num_placed = state.num_placed;
+    header.num_segments = this->size;
+    header.travel_time_length = travel_time->getPackedSize();
+    header.speed_length = speed->getPackedSize();
+    header.seed = (unsigned int) road_ptr->getRandom()->getSeed();
+
+    std::vector<int> spawn_timers;
+    std::vector<double> statistics;
+    if (this->rank == 0) {
+        for (int i = 0; i < this->inputs.num_lanes; i++) {
+            spawn_timers.push_back(road_ptr->getLane(i)->getStepsToSpawn());
+        }
+        statistics.resize(header.travel_time_length + header.speed_length);
+        combined_travel_time.pack(statistics.data());
+        combined_speed.pack(statistics.data() + header.travel_time_length);
+    }
+
+    MPI_Offset segments_offset = sizeof(CheckpointHeader);
+    MPI_Offset timers_offset = segments_offset + (MPI_Offset) this->size * sizeof(CheckpointSegment);
+    MPI_Offset statistics_offset = timers_offset + (MPI_Offset) this->inputs.num_lanes * sizeof(int);
+    MPI_Offset vehicles_offset = statistics_offset +
+                                 (MPI_Offset) (header.travel_time_length + header.speed_length) * sizeof(double);
+
+    // Write the parts of the file with collective writes, every process writes its entry in the table of the segments
+    // and its Vehicles at their place in the list
+    std::string temporary_path = path + ".tmp";
+    MPI_File file;
+    int status = MPI_File_open(this->comm, temporary_path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                               &file);
+    if (status != MPI_SUCCESS) {
+        if (this->rank == 0) {
+            std::cout << "error: failure to open \"" << temporary_path << "\" file!" << std::endl;
+        }
+        return 1;
+    }
+    MPI_File_set_size(file, 0);
+    int header_bytes = (this->rank == 0) ? sizeof(CheckpointHeader) : 0;
+    MPI_File_write_at_all(file, 0, &header, header_bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(file, segments_offset + (MPI_Offset) this->rank * sizeof(CheckpointSegment), &segment,
+                          sizeof(CheckpointSegment), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(file, timers_offset, spawn_timers.data(), spawn_timers.size(), MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(file, statistics_offset, statistics.data(), statistics.size(), MPI_DOUBLE,
+                          MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(file, vehicles_offset + segment.first_vehicle * (MPI_Offset) sizeof(VehicleData),
+                          records.data(), records.size(), this->vehicle_type, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+
+    if (this->rank == 0 && std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        std::cout << "error: failure to rename \"" << temporary_path << "\" file!" << std::endl;
+        return 1;
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Restarts the simulation from a checkpoint file, with collective reads of all the processes. Every process reads the
+ * Vehicles of the segments that overlap its own segment and keeps the ones inside it, and the first process takes the
+ * times to the next spawn and the combined Statistics. On the same number of processes as the checkpoint, the segments
+ * are moved and resized to the segments of the checkpoint first. The Road must be empty, and its ghost sites have to be
+ * exchanged afterwards.
+ * @param path path of the checkpoint file
+ * @param state_ptr pointer to the state of the simulation outside the Road, set from the checkpoint
+ * @param segment_start_ptr pointer to the site of the Road at the start of the segment, set on the restart
+ * @param road_ptr pointer to the Road of the segment
+ * @param vehicles pointer to the list of Vehicles in the segment
+ * @param travel_time pointer to the travel time Statistic of the process
+ * @param speed pointer to the speed Statistic of the process
+ * @return 0 if successful, nonzero otherwise
+ */
+int Checkpoint::read(std::string path, CheckpointState* state_ptr, int* segment_start_ptr, Road* road_ptr,
+                     std::vector<Vehicle*>* vehicles, Statistic* travel_time, Statistic* speed) {
+    MPI_File file;
+    int status = MPI_File_open(this->comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+    if (status != MPI_SUCCESS) {
+        if (this->rank == 0) {
+            std::cout << "error: failure to open \"" << path << "\" file!" << std::endl;
+        }
+        return 1;
+    }
+
+    // Check that the checkpoint was written for the same Road, the other inputs may change on a restart
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    MPI_File_read_at_all(file, 0, &header, sizeof(CheckpointHeader), MPI_BYTE, MPI_STATUS_IGNORE);
+    std::string error;
+    if (std::memcmp(header.magic, "CATSCKPT", 8) != 0 || header.version != Checkpoint::VERSION) {
+        error = "\"" + path + "\" is not a checkpoint of this version of the simulation";
+    } else if (header.num_lanes != this->inputs.num_lanes || header.length != this->inputs.length ||
+               header.periodic != this->inputs.periodic) {
+        error = "the checkpoint was written for a road with a different number of lanes, length or periodicity";
+    } else if (header.travel_time_length != travel_time->getPackedSize() ||
+               header.speed_length != speed->getPackedSize()) {
+        error = "the checkpoint was written with a different setting of the quantiles";
+    }
+    if (!error.empty()) {
+        if (this->rank == 0) {
+            std::cout << "error: " << error << "!" << std::endl;
+        }
+        MPI_File_close(&file);
+        return 1;
+    }
+
+    // Read the table of the segments, the times to the next spawn and the Statistics
+    std::vector<CheckpointSegment> segments(header.num_segments);
+    std::vector<int> spawn_timers(header.num_lanes);
+    std::vector<double> statistics(header.travel_time_length + header.speed_length);
+    MPI_Offset segments_offset = sizeof(CheckpointHeader);
+    MPI_Offset timers_offset = segments_offset + (MPI_Offset) header.num_segments * sizeof(CheckpointSegment);
+    MPI_Offset statistics_offset = timers_offset + (MPI_Offset) header.num_lanes * sizeof(int);
+    MPI_Offset vehicles_offset = statistics_offset + (MPI_Offset) statistics.size() * sizeof(double);
+    MPI_File_read_at_all(file, segments_offset, segments.data(), segments.size() * sizeof(CheckpointSegment),
+                         MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_read_at_all(file, timers_offset, spawn_timers.data(), spawn_timers.size(), MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_read_at_all(file, statistics_offset, statistics.data(), statistics.size(), MPI_DOUBLE,
+                         MPI_STATUS_IGNORE);
+
+    // Keep the boundaries of the segments on the same number of processes, which may wrap around the end of a ring
+    int segment_size;
+    int segment_start = 0;
+    if (header.num_segments == this->size) {
+        road_ptr->resize(segments[this->rank].size);
+        segment_size = segments[this->rank].size;
+        segment_start = segments[this->rank].start;
+    } else {
+        segment_size = road_ptr->getLane(0)->getSize();
+        MPI_Exscan(&segment_size, &segment_start, 1, MPI_INT, MPI_SUM, this->comm);
+        if (this->rank == 0) {
+            segment_start = 0;
+        }
+    }
+    int length = this->inputs.length;
+
+    // Read the Vehicles of the segments of the checkpoint that overlap the segment, they are contiguous in the file
+    // unless the segment overlaps the first and the last segments, and then the Vehicles in between are read as well
+    long long first_vehicle = 0;
+    long long last_vehicle = 0;
+    bool found = false;
+    for (CheckpointSegment other : segments) {
+        if ((other.start - segment_start + length) % length < segment_size ||
+            (segment_start - other.start + length) % length < other.size) {
+            if (!found) {
+                first_vehicle = other.first_vehicle;
+                found = true;
+            }
+            last_vehicle = other.first_vehicle + other.num_vehicles;
+        }
+    }
+    std::vector<VehicleData> records(last_vehicle - first_vehicle);
+    MPI_File_read_at_all(file, vehicles_offset + first_vehicle * (MPI_Offset) sizeof(VehicleData), records.data(),
+                         records.size(), this->vehicle_type, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+
+    // Place the Vehicles inside the segment, in the order that they were written
+    for (VehicleData vdata : records) {
+        vdata.position = (vdata.position - segment_start + length) % length;
+        if (vdata.position >= segment_size) {
+            continue;
+        }
+        Vehicle* new_vehicle = road_ptr->getVehiclePool()->acquire(vdata.lane, vdata.id, vdata.position,
+                                                                   vdata.vehicle_class);
+        new_vehicle->setSpeed(vdata.speed);
+        new_vehicle->setTimeOnRoad(vdata.time_on_road);
+        road_ptr->getLane(vdata.lane)->addVehicle(vdata.position);
+        vehicles->push_back(new_vehicle);
+    }
+
+    // Only the first process spawns Vehicles, and it takes the combined Statistics so that they are counted once
+    if (this->rank == 0) {
+        for (int i = 0; i < header.num_lanes; i++) {
+            road_ptr->getLane(i)->setStepsToSpawn(spawn_timers[i]);
+        }
+        travel_time->unpack(statistics.data());
+        speed->unpack(statistics.data() + header.travel_time_length);
+    }
+    road_ptr->getRandom()->setSeed(header.seed);
+    state_ptr->time = header.time;
+    state_ptr->next_id = header.next_id;
+    state_ptr->num_placed = header.num_placed;
+    *segment_start_ptr = segment_start;
+
+    // Return with no errors
+    return 0;
+}
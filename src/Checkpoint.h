@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_CHECKPOINT_H
+#define CA_TRAFFIC_SIMULATION_CHECKPOINT_H
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+
+#include "Inputs.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "Statistic.h"
+#include "HaloExchange.h"
+
+/**
+ * Structure for the state of the simulation outside the Road that is saved in a checkpoint
+ */
+struct CheckpointState {
+    int time;
+    int next_id;
+    int num_placed;
+};
+
+/**
+ * Header at the start of a checkpoint file, with the shape of the Road that the checkpoint can be restarted on
+ */
+struct CheckpointHeader {
+    char magic[8];
+    long long num_vehicles;
+    int version;
+    int num_lanes;
+    int length;
+    int periodic;
+    int time;
+    int next_id;
+    int num_placed;
+    int num_segments;
+    int travel_time_length;
+    int speed_length;
+    unsigned int seed;
+};
+
+/**
+ * Entry of a checkpoint file for the segment of one process, with the range of Vehicles that it wrote
+ */
+struct CheckpointSegment {
+    long long first_vehicle;
+    long long num_vehicles;
+    int start;
+    int size;
+};
+
+/**
+ * Class for writing the state of the simulation to a single binary file with collective MPI-IO writes, and restarting
+ * from it. The file holds the header, a table of the segments of the processes that wrote it, the times to the next
+ * spawn of the Lanes, the Statistics combined across the processes and the Vehicles of all the segments in the order
+ * of the segments, with their positions on the whole Road. The random numbers only depend on the seed and the step,
+ * so the seed is the whole state of the generator. Since the Vehicles are stored by their position on the whole Road,
+ * a checkpoint can be restarted on a different number of processes, and the segments keep their boundaries if it is
+ * restarted on the same number of processes, even after a rebalance on a ring moved them around the end of the ring.
+ * The file is written in the native representation of the machine.
+ */
+class Checkpoint {
+private:
+    MPI_Comm comm;
+    int rank;
+    int size;
+    Inputs inputs;
+    MPI_Datatype vehicle_type;
+public:
+    static constexpr int VERSION = 2;
+
+    Checkpoint(Inputs inputs, MPI_Comm comm);
+    ~Checkpoint();
+    int write(std::string path, CheckpointState state, int segment_start, Road* road_ptr,
+              std::vector<Vehicle*>* vehicles, Statistic* travel_time, Statistic* speed);
+    int read(std::string path, CheckpointState* state_ptr, int* segment_start_ptr, Road* road_ptr,
+             std::vector<Vehicle*>* vehicles, Statistic* travel_time, Statistic* speed);
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_CHECKPOINT_H
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <iostream>
+
+#include "Detectors.h"
+
+/**
+ * Constructor for the Detectors, the output file is opened with open and the segment is set with setSegment
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @param comm Cartesian communicator of the segments of the Road
+ */
+Detectors::Detectors(Inputs inputs, MPI_Comm comm) {
+    this->comm = comm;
+    this->inputs = inputs;
+    MPI_Comm_rank(comm, &(this->rank));
+    this->num_detectors = (inputs.length - 1) / inputs.detector_spacing + 1;
+    this->segment_start = 0;
+    this->segment_size = 0;
+
+    // Every detector has the number of the Vehicles that crossed it at every speed, kept for all the detectors of the
+    // Road so that the segment can be resized at any step
+    int num_counts = this->num_detectors * inputs.max_speed;
+    this->counts.assign(num_counts, 0);
+    this->sending.assign(num_counts, 0);
+    if (this->rank == 0) {
+        this->totals.assign(num_counts, 0);
+    }
+    this->request = MPI_REQUEST_NULL;
+    this->pending_step = 0;
+}
+
+/**
+ * Destructor for the Detectors, completes the reduction in flight and closes the file
+ */
+Detectors::~Detectors() {
+    if (this->request != MPI_REQUEST_NULL) {
+        this->close();
+    }
+}
+
+/**
+ * Creates the output file on the first process, replacing an existing one, and writes its header. Has to be called by
+ * all the processes.
+ * @param path path of the output file
+ * @return 0 if successful, nonzero otherwise, the same on every process
+ */
+int Detectors::open(std::string path) {
+    int status = 0;
+    if (this->rank == 0) {
+        this->file.open(path);
+        if (!this->file) {
+            std::cout << "error: failure to open \"" << path << "\" file!" << std::endl;
+            status = 1;
+        } else {
+            this->file << "step,detector,site,vehicles,flow,density,speed" << std::endl;
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, this->comm);
+
+    // Return the status of the first process
+    return status;
+}
+
+/**
+ * Sets the segment of the process on the Road and marks the sites of the detectors in the segment, whenever the
+ * segment is resized
+ * @param segment_start the site of the Road at the start of the segment
+ * @param segment_size number of sites in the segment of the process
+ * @return 0 if successful, nonzero otherwise
+ */
+int Detectors::setSegment(int segment_start, int segment_size) {
+    this->segment_start = segment_start;
+    this->segment_size = segment_size;
+
+    // The detectors are at the multiples of the spacing on the whole Road, and site 0 follows the end of a ring
+    int length = this->inputs.length;
+    int spacing = this->inputs.detector_spacing;
+    this->bits.assign((segment_size + 63) / 64, 0);
+    int site = 0;
+    while (site < segment_size) {
+        int global_site = (segment_start + site) % length;
+        int to_next = spacing - global_site % spacing;
+        if (global_site % spacing == 0) {
+            this->bits[site >> 6] |= UINT64_C(1) << (site & 63);
+            site++;
+        } else {
+            site += std::min(to_next, length - global_site);
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Completes the reduction in flight and, on the first process, writes the points of the fundamental diagram of every
+ * detector for the interval that ended at the step of the reduction. The flow is in Vehicles per step per Lane, the
+ * density is the time the Vehicles spent at the site per step per Lane, which is the sum of the inverses of their
+ * speeds, and the speed is the space mean speed, the flow over the density. The sums are taken over the speeds in
+ * order, so they do not depend on the order of the crossings.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Detectors::wait() {
+    if (this->request == MPI_REQUEST_NULL) {
+        return 0;
+    }
+    MPI_Wait(&(this->request), MPI_STATUS_IGNORE);
+    if (this->rank == 0) {
+        double lane_steps = (double) this->inputs.detector_interval * this->inputs.num_lanes;
+        for (int d = 0; d < this->num_detectors; d++) {
+            long long* detector = &(this->totals[d * this->inputs.max_speed]);
+            long long num_vehicles = 0;
+            double inverse_speeds = 0.0;
+            for (int v = 1; v <= this->inputs.max_speed; v++) {
+                num_vehicles += detector[v - 1];
+                inverse_speeds += (double) detector[v - 1] / v;
+            }
+            double speed = (inverse_speeds > 0.0) ? num_vehicles / inverse_speeds : 0.0;
+            this->file << this->pending_step << "," << d << "," << d * this->inputs.detector_spacing << ","
+                       << num_vehicles << "," << num_vehicles / lane_steps << "," << inverse_speeds / lane_steps
+                       << "," << speed << "\n";
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Counts a Vehicle that left the segment and is handed over to the next segment at the detectors of the sites that it
+ * crossed past the end of the segment, in the step of the move, so that the crossing is counted in the same interval
+ * on any number of processes
+ * @param to the site that the Vehicle moved to, relative to the start of the next segment
+ * @param speed the speed of the Vehicle, above zero
+ * @return 0 if successful, nonzero otherwise
+ */
+int Detectors::recordHandOver(int to, int speed) {
+    for (int site = 0; site <= to; site++) {
+        int global_site = (this->segment_start + this->segment_size + site) % this->inputs.length;
+        if (global_site % this->inputs.detector_spacing == 0) {
+            this->counts[(global_site / this->inputs.detector_spacing) * this->inputs.max_speed + speed - 1]++;
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Starts the reduction of the counts of the detectors since the last reduction to the first process, which is left in
+ * flight until the next reduction. Has to be called by all the processes at the same step.
+ * @param step the step at the end of the interval
+ * @return 0 if successful, nonzero otherwise
+ */
+int Detectors::reduce(int step) {
+    this->wait();
+    this->counts.swap(this->sending);
+    std::fill(this->counts.begin(), this->counts.end(), 0);
+    MPI_Ireduce(this->sending.data(), this->totals.data(), this->counts.size(), MPI_LONG_LONG, MPI_SUM, 0, this->comm,
+                &(this->request));
+    this->pending_step = step;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Completes the reduction in flight, writing its points, and closes the output file
+ * @return 0 if successful, nonzero otherwise
+ */
+int Detectors::close() {
+    this->wait();
+    if (this->file.is_open()) {
+        this->file.close();
+    }
+
+    // Return with no errors
+    return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_DETECTORS_H
+#define CA_TRAFFIC_SIMULATION_DETECTORS_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <algorithm>
+#include <mpi.h>
+
+#include "Inputs.h"
+#include "GapKernel.h"
+
+/**
+ * Class for the detectors of the Road, one at every detector_spacing sites across all the Lanes. A detector counts the
+ * Vehicles that cross its site as they move by their speed, so the measurements cost nothing for the Vehicles that do
+ * not cross a detector in a step. Every detector_interval steps the counts of all the processes are reduced to the
+ * first process in the background, which writes the flow, the density and the space mean speed of every detector as a
+ * point of the fundamental diagram. A crossing is counted in the step that it happens, by the process that owns the
+ * site of the detector or, for a Vehicle that is handed over to the next segment, by the process that hands it over.
+ * The counts are integers, so the points do not depend on the partitioning of the Road. The segment of a process may
+ * wrap around the end of a ring once its boundaries have moved.
+ */
+class Detectors {
+private:
+    MPI_Comm comm;
+    int rank;
+    Inputs inputs;
+    int num_detectors;
+    int segment_start;
+    int segment_size;
+    std::vector<uint64_t> bits;
+    std::vector<long long> counts;
+    std::vector<long long> sending;
+    std::vector<long long> totals;
+    MPI_Request request;
+    int pending_step;
+    std::ofstream file;
+    int wait();
+public:
+    Detectors(Inputs inputs, MPI_Comm comm);
+    ~Detectors();
+    int open(std::string path);
+    int setSegment(int segment_start, int segment_size);
+    int recordHandOver(int to, int speed);
+    int reduce(int step);
+    int close();
+
+    /**
+     * Counts a Vehicle that moved from one site to another with a speed at the detectors of the sites it crossed,
+     * leaving out the sites outside the segment, which are counted by recordHandOver for a Vehicle that is handed over
+     * and by the processes that own them otherwise
+     * @param from the site that the Vehicle moved from
+     * @param to the site that the Vehicle moved to, past the end of the segment if it left the segment
+     * @param speed the speed of the Vehicle, above zero
+     */
+    inline void recordMove(int from, int to, int speed) {
+        int first = std::max(from + 1, 0);
+        int last = std::min(to, this->segment_size - 1);
+        if (first > last) {
+            return;
+        }
+        int site = GapKernel::firstSet(this->bits.data(), 1, first, last);
+        while (site <= last) {
+            int global_site = this->segment_start + site;
+            if (global_site >= this->inputs.length) {
+                global_site -= this->inputs.length;
+            }
+            this->counts[(global_site / this->inputs.detector_spacing) * this->inputs.max_speed + speed - 1]++;
+            site = (site < last) ? GapKernel::firstSet(this->bits.data(), 1, site + 1, last) : last + 1;
+        }
+    }
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_DETECTORS_H
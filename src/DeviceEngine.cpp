@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "DeviceEngine.h"
+#include "Random.h"
+
+#pragma omp declare target
+/**
+ * Locates the first occupied site at or after a site of a Lane in the occupancy bytes of all the Lanes
+ * @param occupancy occupancy of the sites of all the Lanes, interleaved by Lane
+ * @param num_lanes number of Lanes of the Road
+ * @param lane the Lane to search
+ * @param index the index of the first site to check, counted from the first ghost site
+ * @param reach the number of sites after the first site to check
+ * @return the index of the first occupied site, or index + reach + 1 if there is none
+ */
+static inline int nextOccupied(const unsigned char* occupancy, int num_lanes, int lane, int index, int reach) {
+    for (int k = index; k <= index + reach; k++) {
+        if (occupancy[(size_t) k * num_lanes + lane] != 0) {
+            return k;
+        }
+    }
+    return index + reach + 1;
+}
+
+/**
+ * Locates the last occupied site at or before a site of a Lane in the occupancy bytes of all the Lanes
+ * @param occupancy occupancy of the sites of all the Lanes, interleaved by Lane
+ * @param num_lanes number of Lanes of the Road
+ * @param lane the Lane to search
+ * @param index the index of the first site to check, counted from the first ghost site
+ * @param reach the number of sites before the first site to check
+ * @return the index of the last occupied site, or index - reach - 1 if there is none
+ */
+static inline int prevOccupied(const unsigned char* occupancy, int num_lanes, int lane, int index, int reach) {
+    for (int k = index; k >= index - reach; k--) {
+        if (occupancy[(size_t) k * num_lanes + lane] != 0) {
+            return k;
+        }
+    }
+    return index - reach - 1;
+}
+#pragma omp end declare target
+
+/**
+ * Constructor for the DeviceEngine, the state of the Vehicles is copied to the device with upload
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @param road_ptr pointer to the Road with the segment of the process
+ */
+DeviceEngine::DeviceEngine(Inputs inputs, Road* road_ptr) {
+    this->inputs = inputs;
+    this->road_ptr = road_ptr;
+#ifdef _OPENMP
+    this->device = omp_get_default_device();
+#else
+    this->device = 0;
+#endif
+    this->resident = false;
+    this->num_listed = 0;
+    this->capacity = 0;
+    this->num_sites = 0;
+    this->num_words = 0;
+
+    // The parameters of the classes of the Vehicles are flattened into arrays that can be mapped to the device
+    VehicleStore* store_ptr = road_ptr->getVehicleStore();
+    this->num_classes = store_ptr->classes.size();
+    for (VehicleClass vehicle_class : store_ptr->classes) {
+        this->max_speeds.push_back(vehicle_class.max_speed);
+        this->slow_down_probs.push_back(vehicle_class.prob_slow_down);
+        this->change_probs.push_back(vehicle_class.prob_change);
+    }
+    this->class_max_speed = this->max_speeds.data();
+    this->class_prob_slow_down = this->slow_down_probs.data();
+    this->class_prob_change = this->change_probs.data();
+}
+
+/**
+ * Destructor for the DeviceEngine, copies the state of the Vehicles back and frees it on the device
+ */
+DeviceEngine::~DeviceEngine() {
+    this->release();
+}
+
+/**
+ * Getter for the number of offload devices that are available to the process
+ * @return number of devices, zero if the kernels run on the host
+ */
+int DeviceEngine::getNumDevices() {
+#ifdef _OPENMP
+    return omp_get_num_devices();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Copies the state of the Vehicles and the occupancy of the sites to the device, after an exchange of the ghost
+ * Vehicles. The Vehicles are updated in the order of the list until the state is released, and no Vehicle can be added
+ * in the meantime.
+ * @param vehicles pointer to the list of the Vehicles of the segment, with the ghost Vehicles
+ * @return 0 if successful, nonzero otherwise
+ */
+int DeviceEngine::upload(std::vector<Vehicle*>* vehicles) {
+    this->release();
+
+    VehicleStore* s = this->road_ptr->getVehicleStore();
+    this->num_listed = vehicles->size();
+    this->listed_slots.resize(this->num_listed);
+    for (int n = 0; n < this->num_listed; n++) {
+        this->listed_slots[n] = (*vehicles)[n]->getSlot();
+    }
+    this->capacity = s->id.size();
+    this->left.assign(this->capacity, 0);
+    this->slots = this->listed_slots.data();
+    this->gone = this->left.data();
+    this->num_sites = this->road_ptr->getOccupancy()->size();
+    this->num_words = this->road_ptr->getBits()->size();
+
+    // Point to the arrays of the host, the device has its own copies of the same arrays
+    this->lane = s->lane.data();
+    this->id = s->id.data();
+    this->position = s->position.data();
+    this->new_position = s->new_position.data();
+    this->speed = s->speed.data();
+    this->time_on_road = s->time_on_road.data();
+    this->switching = s->switching.data();
+    this->vehicle_class = s->vehicle_class.data();
+    this->occupancy = this->road_ptr->getOccupancy()->data();
+    this->bits = this->road_ptr->getBits()->data();
+
+#pragma omp target enter data device(this->device) \
+    map(to: this->slots[0:this->num_listed], this->gone[0:this->capacity], \
+        this->class_max_speed[0:this->num_classes], this->class_prob_slow_down[0:this->num_classes], \
+        this->class_prob_change[0:this->num_classes], this->lane[0:this->capacity], this->id[0:this->capacity], \
+        this->position[0:this->capacity], this->new_position[0:this->capacity], this->speed[0:this->capacity], \
+        this->time_on_road[0:this->capacity], this->switching[0:this->capacity], \
+        this->vehicle_class[0:this->capacity], this->occupancy[0:this->num_sites]) \
+    map(alloc: this->bits[0:this->num_words])
+    this->resident = true;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Changes the lanes of all the Vehicles that decided to change lanes in one direction. A site can only be taken by
+ * the Vehicle beside it in the Lane on the other side, so the Vehicles of one direction do not race, and the changes
+ * to higher Lanes are made first and have priority, as on the host.
+ * @param direction the direction of the lane changes
+ * @return 0 if successful, nonzero otherwise
+ */
+int DeviceEngine::applyLaneSwitches(int direction) {
+    int num_lanes = this->inputs.num_lanes;
+    int ghost_width = this->road_ptr->getLane(0)->getGhostWidth();
+    int num_listed = this->num_listed;
+    int* slots = this->slots;
+    unsigned char* gone = this->gone;
+    int* lane = this->lane;
+    int* position = this->position;
+    signed char* switching = this->switching;
+    unsigned char* occupancy = this->occupancy;
+#pragma omp target teams distribute parallel for device(this->device)
+    for (int u = 0; u < num_listed; u++) {
+        int n = slots[u];
+        if (gone[n] || switching[n] != direction) {
+            continue;
+        }
+        switching[n] = 0;
+        size_t site = (size_t) (position[n] + ghost_width) * num_lanes;
+        if (occupancy[site + lane[n] + direction] != 0) {
+            continue;
+        }
+        occupancy[site + lane[n] + direction] = 1;
+        occupancy[site + lane[n]] = 0;
+        lane[n] += direction;
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Performs one step of the synchronous update of the Vehicles on the device, as Simulation::stepLocal does on the
+ * host. The Vehicles that leave the exit site of the segment are marked, and only those are copied back to the host to
+ * be removed from the list.
+ * @param vehicles pointer to the list of the Vehicles of the segment, without the Vehicles removed since the upload
+ * @param vehicles_to_remove pointer to the list of the indexes of the Vehicles to remove after the step
+ * @return 0 if successful, nonzero otherwise
+ */
+int DeviceEngine::step(std::vector<Vehicle*>* vehicles, std::vector<int>* vehicles_to_remove) {
+    Lane* lane_ptr = this->road_ptr->getLane(0);
+    int num_lanes = this->inputs.num_lanes;
+    int max_speed = this->inputs.max_speed;
+    int look_other_backward = this->inputs.look_other_backward;
+    int ghost_width = lane_ptr->getGhostWidth();
+    int exit_site = lane_ptr->getExitSite();
+    int size = lane_ptr->getSize();
+    int num_listed = this->num_listed;
+    Random random = *(this->road_ptr->getRandom());
+    int* slots = this->slots;
+    unsigned char* gone = this->gone;
+    int* class_max_speed = this->class_max_speed;
+    double* class_prob_slow_down = this->class_prob_slow_down;
+    double* class_prob_change = this->class_prob_change;
+    int* lane = this->lane;
+    int* id = this->id;
+    int* position = this->position;
+    int* new_position = this->new_position;
+    int* speed = this->speed;
+    int* time_on_road = this->time_on_road;
+    signed char* switching = this->switching;
+    unsigned char* vehicle_class = this->vehicle_class;
+    unsigned char* occupancy = this->occupancy;
+
+    // Decide on the lane changes from the same state, with the gaps of Vehicle::updateGaps
+#pragma omp target teams distribute parallel for device(this->device) firstprivate(random)
+    for (int u = 0; u < num_listed; u++) {
+        int n = slots[u];
+        if (gone[n]) {
+            continue;
+        }
+        int index = position[n] + ghost_width;
+        int gap_forward = nextOccupied(occupancy, num_lanes, lane[n], index + 1, max_speed) - index - 1;
+        int look_forward = speed[n] + 1;
+        switching[n] = 0;
+        if (gap_forward < look_forward) {
+            bool open[2];
+            int gap_other_forward[2];
+            for (int side = 0; side < 2; side++) {
+                int other_lane = lane[n] + ((side == 0) ? -1 : 1);
+                open[side] = false;
+                gap_other_forward[side] = -1;
+                if (other_lane >= 0 && other_lane < num_lanes) {
+                    gap_other_forward[side] =
+                        nextOccupied(occupancy, num_lanes, other_lane, index, max_speed + 2) - index - 1;
+                    int gap_other_backward =
+                        index - prevOccupied(occupancy, num_lanes, other_lane, index, look_other_backward + 1) - 1;
+                    open[side] = gap_other_forward[side] > look_forward && gap_other_backward > look_other_backward;
+                }
+            }
+            if (open[0] || open[1]) {
+                double prob_change = class_prob_change[vehicle_class[n]];
+                double uniform = random.uniform(Random::LANE_SWITCH, id[n]);
+                if (uniform <= prob_change) {
+                    int side = open[0] ? 0 : 1;
+                    if (open[0] && open[1]) {
+                        if (gap_other_forward[0] != gap_other_forward[1]) {
+                            side = (gap_other_forward[1] > gap_other_forward[0]) ? 1 : 0;
+                        } else {
+                            side = (uniform < 0.5 * prob_change) ? 0 : 1;
+                        }
+                    }
+                    switching[n] = (side == 0) ? Vehicle::LOWER : Vehicle::HIGHER;
+                }
+            }
+        }
+    }
+    this->applyLaneSwitches(Vehicle::HIGHER);
+    this->applyLaneSwitches(Vehicle::LOWER);
+
+    // Update the speeds from the same state, as Vehicle::updateSpeed
+#pragma omp target teams distribute parallel for device(this->device) firstprivate(random)
+    for (int u = 0; u < num_listed; u++) {
+        int n = slots[u];
+        if (gone[n]) {
+            continue;
+        }
+        int index = position[n] + ghost_width;
+        int gap_forward = nextOccupied(occupancy, num_lanes, lane[n], index + 1, max_speed) - index - 1;
+        time_on_road[n]++;
+        int new_speed = speed[n];
+        if (new_speed < class_max_speed[vehicle_class[n]]) {
+            new_speed++;
+        }
+        new_speed = (new_speed < gap_forward) ? new_speed : gap_forward;
+        if (new_speed > 0 && random.uniform(Random::SLOW_DOWN, id[n]) <= class_prob_slow_down[vehicle_class[n]]) {
+            new_speed--;
+        }
+        speed[n] = new_speed;
+    }
+
+    // Move all the Vehicles at once, every Vehicle writes its own site and the site it moves to, which no other
+    // Vehicle writes
+    int num_left = 0;
+#pragma omp target teams distribute parallel for device(this->device) reduction(+:num_left)
+    for (int u = 0; u < num_listed; u++) {
+        int n = slots[u];
+        if (gone[n] || speed[n] == 0) {
+            continue;
+        }
+        int moved = position[n] + speed[n];
+        occupancy[(size_t) (position[n] + ghost_width) * num_lanes + lane[n]] = 0;
+        if (moved >= exit_site) {
+            new_position[n] = moved - size;
+            gone[n] = 1;
+            num_left++;
+        } else {
+            occupancy[(size_t) (moved + ghost_width) * num_lanes + lane[n]] = 1;
+            position[n] = moved;
+        }
+    }
+
+    // Mark the Vehicles that left the segment for removal, which are the Vehicles of the list that are marked now
+    if (num_left > 0) {
+#pragma omp target update device(this->device) from(this->gone[0:this->capacity])
+        for (int n = 0; n < (int) vehicles->size(); n++) {
+            if (gone[(*vehicles)[n]->getSlot()]) {
+                vehicles_to_remove->push_back(n);
+            }
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Copies the positions and the speeds of the Vehicles back to the host, for the speeds to be measured
+ * @return 0 if successful, nonzero otherwise
+ */
+int DeviceEngine::fetchSpeeds() {
+    if (!this->resident) {
+        return 0;
+    }
+#pragma omp target update device(this->device) from(this->position[0:this->capacity], this->speed[0:this->capacity])
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Rebuilds the bitsets of the Lanes from the occupancy bytes on the device, a word of one Lane per thread
+ * @return 0 if successful, nonzero otherwise
+ */
+int DeviceEngine::rebuildBits() {
+    int num_lanes = this->inputs.num_lanes;
+    int lane_sites = this->num_sites / num_lanes;
+    int num_words = this->num_words;
+    unsigned char* occupancy = this->occupancy;
+    uint64_t* bits = this->bits;
+#pragma omp target teams distribute parallel for device(this->device)
+    for (int w = 0; w < num_words; w++) {
+        int first_site = (w / num_lanes) * 64;
+        int lane = w % num_lanes;
+        uint64_t word = 0;
+        for (int b = 0; b < 64 && first_site + b < lane_sites; b++) {
+            if (occupancy[(size_t) (first_site + b) * num_lanes + lane] != 0) {
+                word |= UINT64_C(1) << b;
+            }
+        }
+        bits[w] = word;
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Copies the state of the Vehicles and of the sites back to the host, which keeps the state on the device, for the
+ * checkpoints and the output of the Road
+ * @return 0 if successful, nonzero otherwise
+ */
+int DeviceEngine::fetch() {
+    if (!this->resident) {
+        return 0;
+    }
+    this->rebuildBits();
+#pragma omp target update device(this->device) \
+    from(this->lane[0:this->capacity], this->position[0:this->capacity], this->new_position[0:this->capacity], \
+         this->speed[0:this->capacity], this->time_on_road[0:this->capacity], this->occupancy[0:this->num_sites], \
+         this->bits[0:this->num_words])
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Copies the state of the Vehicles and of the sites back to the host and frees it on the device, before the ghost
+ * Vehicles are exchanged again
+ * @return 0 if successful, nonzero otherwise
+ */
+int DeviceEngine::release() {
+    if (!this->resident) {
+        return 0;
+    }
+    this->fetch();
+#pragma omp target exit data device(this->device) \
+    map(delete: this->slots[0:this->num_listed], this->gone[0:this->capacity], \
+        this->class_max_speed[0:this->num_classes], this->class_prob_slow_down[0:this->num_classes], \
+        this->class_prob_change[0:this->num_classes], this->lane[0:this->capacity], this->id[0:this->capacity], \
+        this->position[0:this->capacity], this->new_position[0:this->capacity], this->speed[0:this->capacity], \
+        this->time_on_road[0:this->capacity], this->switching[0:this->capacity], \
+        this->vehicle_class[0:this->capacity], this->occupancy[0:this->num_sites], this->bits[0:this->num_words])
+    this->resident = false;
+
+    // Return with no errors
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_DEVICEENGINE_H
+#define CA_TRAFFIC_SIMULATION_DEVICEENGINE_H
+
+#include <vector>
+#include <cstdint>
+
+#include "Inputs.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "VehicleStore.h"
+
+/**
+ * Class for the synchronous update of the Vehicles on an accelerator, offloaded with OpenMP target regions. Between
+ * two exchanges of the ghost Vehicles the segment needs no communication, so the state of the Vehicles and the
+ * occupancy of the sites stay on the device for the whole exchange interval and every phase of a step is a kernel with
+ * one thread per Vehicle. The kernels work on the occupancy bytes alone, since the changes of lanes and the moves of
+ * the Vehicles write distinct sites and can not race, and the bitsets are rebuilt from the bytes when the state is
+ * copied back. The random numbers are drawn from the same counter-based generator as on the host, so the results are
+ * the same as with the local update of the Simulation. Without an offload device the kernels run on the host.
+ */
+class DeviceEngine {
+private:
+    Inputs inputs;
+    Road* road_ptr;
+    int device;
+    bool resident;
+    int num_listed;
+    int capacity;
+    int num_classes;
+    int num_sites;
+    int num_words;
+    std::vector<int> listed_slots;
+    std::vector<unsigned char> left;
+    std::vector<int> max_speeds;
+    std::vector<double> slow_down_probs;
+    std::vector<double> change_probs;
+    int* slots;
+    unsigned char* gone;
+    int* class_max_speed;
+    double* class_prob_slow_down;
+    double* class_prob_change;
+    int* lane;
+    int* id;
+    int* position;
+    int* new_position;
+    int* speed;
+    int* time_on_road;
+    signed char* switching;
+    unsigned char* vehicle_class;
+    unsigned char* occupancy;
+    uint64_t* bits;
+    int applyLaneSwitches(int direction);
+    int rebuildBits();
+public:
+    DeviceEngine(Inputs inputs, Road* road_ptr);
+    ~DeviceEngine();
+    static int getNumDevices();
+    int upload(std::vector<Vehicle*>* vehicles);
+    int step(std::vector<Vehicle*>* vehicles, std::vector<int>* vehicles_to_remove);
+    int fetchSpeeds();
+    int fetch();
+    int release();
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_DEVICEENGINE_H
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+#include "Ensemble.h"
+#include "Simulation.h"
+#include "HaloExchange.h"
+
+/**
+ * Constructor for the Ensemble
+ * @param inputs instance of the Inputs class with the parameters that all the replicas share
+ */
+Ensemble::Ensemble(Inputs inputs) {
+    this->inputs = inputs;
+}
+
+/**
+ * Prints an error in the ensemble on the first process, every process finds the same errors
+ * @param message the error message
+ * @return 1, the status of the failed ensemble
+ */
+int Ensemble::reportError(std::string message) {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (world_rank == 0) {
+        std::cout << "error: " << message << "!" << std::endl;
+    }
+    return 1;
+}
+
+/**
+ * Loads the replicas from a text file on the first process and broadcasts their inputs to the other processes. Has to
+ * be called by all the processes.
+ * @param path path of the ensemble file
+ * @return 0 if successful, nonzero otherwise, the same on every process
+ */
+int Ensemble::loadFromFile(std::string path) {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    int status = 0;
+    int num_replicas = 0;
+    if (world_rank == 0) {
+        status = this->readReplicas(path);
+        num_replicas = this->replicas.size();
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (status != 0) {
+        return status;
+    }
+    MPI_Bcast(&num_replicas, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    this->replicas.resize(num_replicas, this->inputs);
+    for (int r = 0; r < num_replicas; r++) {
+        this->replicas[r].broadcast(MPI_COMM_WORLD, 0);
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Reads the replicas from a text file with one replica per line, with the slow down probability, the lane change
+ * probability and optionally the path of the CDF of interarrival times, separated by spaces. Empty lines and lines that
+ * start with # are skipped. The CDF of every replica is read along with it.
+ * @param path path of the ensemble file
+ * @return 0 if successful, nonzero otherwise
+ */
+int Ensemble::readReplicas(std::string path) {
+    std::ifstream ensemble_file(path);
+    if (!ensemble_file) {
+        return this->reportError("failure to open \"" + path + "\" file");
+    }
+
+    std::string line;
+    while (std::getline(ensemble_file, line)) {
+        std::stringstream stream(line);
+        Inputs replica = this->inputs;
+        std::string first;
+        if (!(stream >> first) || first[0] == '#') {
+            continue;
+        }
+        if (!Inputs::parseNumber(first, &(replica.prob_slow_down))) {
+            return this->reportError("invalid slow down probability in \"" + line + "\"");
+        }
+        std::string second;
+        if (!(stream >> second)) {
+            return this->reportError("missing lane change probability in \"" + line + "\"");
+        }
+        if (!Inputs::parseNumber(second, &(replica.prob_change))) {
+            return this->reportError("invalid lane change probability in \"" + line + "\"");
+        }
+        std::string cdf_path;
+        if (stream >> cdf_path && cdf_path != replica.cdf_path) {
+            replica.cdf_path = cdf_path;
+            if (replica.loadCDF() != 0) {
+                return 1;
+            }
+        }
+
+        if (replica.prob_slow_down < 0.0 || replica.prob_slow_down > 1.0 || replica.prob_change < 0.0 ||
+            replica.prob_change > 1.0) {
+            return this->reportError("the probabilities in \"" + line + "\" are not between 0 and 1");
+        }
+        this->replicas.push_back(replica);
+    }
+    if (this->replicas.empty()) {
+        return this->reportError("the ensemble in \"" + path + "\" has no replicas");
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Runs the replicas on the groups of processes and prints the statistics of every replica on the first process, as
+ * comma separated values
+ * @return 0 if successful, nonzero otherwise
+ */
+int Ensemble::run() {
+    int world_rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    // Split the processes into one group per replica, up to the number of processes, the last group takes the
+    // processes that are left over
+    int num_replicas = this->replicas.size();
+    int num_groups = std::min(num_replicas, world_size);
+    int group_size = world_size / num_groups;
+    int largest_group_size = world_size - (num_groups - 1) * group_size;
+    if (this->inputs.length / largest_group_size < HaloExchange::minSegmentSize(this->inputs)) {
+        return this->reportError("the road is too short to be split between " + std::to_string(largest_group_size) +
+                                 " processes");
+    }
+    int color = std::min(world_rank / group_size, num_groups - 1);
+    MPI_Comm group_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, color, world_rank, &group_comm);
+    int group_rank;
+    MPI_Comm_rank(group_comm, &group_rank);
+    MPI_Comm_size(group_comm, &group_size);
+
+    // The statistics of every replica are filled in by the first process of its group
+    std::vector<double> results(num_replicas * Ensemble::NUM_COLUMNS, 0.0);
+    for (int r = color; r < num_replicas; r += num_groups) {
+        Inputs inputs = this->replicas[r];
+        inputs.seed = this->inputs.seed + r;
+        inputs.replica = r;
+
+        // Arrange the processes of the group along the Road, as for a single simulation
+        MPI_Comm road_comm;
+        int dims[1] = {group_size};
+        int periods[1] = {inputs.periodic};
+        MPI_Cart_create(group_comm, 1, dims, periods, 0, &road_comm);
+        int rank;
+        MPI_Comm_rank(road_comm, &rank);
+        int road_length_per_process = inputs.length / group_size + ((rank < inputs.length % group_size) ? 1 : 0);
+
+        Simulation* simulation_ptr = new Simulation(inputs, road_length_per_process);
+        simulation_ptr->run_simulation(road_comm);
+        if (rank == 0) {
+            Statistic* statistic = inputs.periodic ? simulation_ptr->getSpeed() : simulation_ptr->getTravelTime();
+            double* row = results.data() + r * Ensemble::NUM_COLUMNS;
+            row[0] = group_size;
+            row[1] = statistic->getNumSamples();
+            row[2] = statistic->getAverage();
+            row[3] = std::sqrt(statistic->getVariance());
+            row[4] = statistic->getQuantile(0.5);
+            row[5] = statistic->getQuantile(0.9);
+            row[6] = statistic->getQuantile(0.99);
+            row[7] = simulation_ptr->getElapsedTime();
+        }
+
+        delete simulation_ptr;
+        MPI_Comm_free(&road_comm);
+    }
+    MPI_Comm_free(&group_comm);
+
+    // Collect the rows of all the replicas, every row is filled in by one process only
+    MPI_Reduce((world_rank == 0) ? MPI_IN_PLACE : results.data(), results.data(), results.size(), MPI_DOUBLE,
+               MPI_SUM, 0, MPI_COMM_WORLD);
+    if (world_rank != 0) {
+        return 0;
+    }
+
+    // The quantiles are only estimated for the travel time
+    bool quantiles = this->inputs.quantiles != 0 && !this->inputs.periodic;
+    std::cout << "--- Ensemble Results ---" << std::endl;
+    std::cout << "replica,prob_slow_down,prob_change,cdf,seed,ranks,statistic,samples,average,std,"
+              << (quantiles ? "p50,p90,p99," : "") << "time" << std::endl;
+    for (int r = 0; r < num_replicas; r++) {
+        double* row = results.data() + r * Ensemble::NUM_COLUMNS;
+        std::cout << r << "," << this->replicas[r].prob_slow_down << "," << this->replicas[r].prob_change << ","
+                  << this->replicas[r].cdf_path << "," << this->inputs.seed + r << "," << (int) row[0] << ","
+                  << (this->inputs.periodic ? "speed" : "time_on_road") << "," << (long long) row[1] << ","
+                  << row[2] << "," << row[3] << ",";
+        if (quantiles) {
+            std::cout << row[4] << "," << row[5] << "," << row[6] << ",";
+        }
+        std::cout << row[7] << std::endl;
+    }
+
+    // Return with no errors
+    return 0;
+}
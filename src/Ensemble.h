@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_ENSEMBLE_H
+#define CA_TRAFFIC_SIMULATION_ENSEMBLE_H
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+
+#include "Inputs.h"
+
+/**
+ * Class for running an ensemble of independent simulations in a single launch of the program. The processes are split
+ * into groups of the same size, one per replica up to the number of processes, and every group runs its share of the
+ * replicas one after the other on its own communicator. Every replica has its own slow down and lane change
+ * probabilities, CDF of interarrival times and seed, and the statistics of all the replicas are collected on the first
+ * process at the end. The ensemble file and the CDFs are read on the first process only, which broadcasts the inputs
+ * of every replica.
+ */
+class Ensemble {
+private:
+    Inputs inputs;
+    std::vector<Inputs> replicas;
+    int reportError(std::string message);
+    int readReplicas(std::string path);
+public:
+    static constexpr int NUM_COLUMNS = 8;
+
+    Ensemble(Inputs inputs);
+    int loadFromFile(std::string path);
+    int run();
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_ENSEMBLE_H
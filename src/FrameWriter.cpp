@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#include "FrameWriter.h"
+#include "Lane.h"
+
+/**
+ * Constructor for the FrameWriter, the file is opened with open
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @param comm Cartesian communicator of the segments of the Road
+ */
+FrameWriter::FrameWriter(Inputs inputs, MPI_Comm comm) {
+    this->comm = comm;
+    this->inputs = inputs;
+    MPI_Comm_rank(comm, &(this->rank));
+    MPI_Comm_size(comm, &(this->size));
+    this->is_open = false;
+    this->next_offset = 0;
+    this->num_frames = 0;
+    this->segment_starts.resize(this->size);
+    this->segment_sizes.resize(this->size);
+    this->requests[0] = MPI_REQUEST_NULL;
+    this->requests[1] = MPI_REQUEST_NULL;
+}
+
+/**
+ * Destructor for the FrameWriter, completes the writes in flight and closes the file
+ */
+FrameWriter::~FrameWriter() {
+    if (this->is_open) {
+        this->close();
+    }
+}
+
+/**
+ * Gets the number of bytes of the chunk of a segment in a frame
+ * @param segment_size number of sites in the segment
+ * @return number of bytes of the occupancy and the aggregates of the segment
+ */
+long long FrameWriter::chunkBytes(int segment_size) {
+    long long num_words = (segment_size + 63) / 64;
+    long long num_blocks = (segment_size + this->inputs.output_block - 1) / this->inputs.output_block;
+    return this->inputs.num_lanes * num_words * sizeof(uint64_t) + 3 * num_blocks * sizeof(float);
+}
+
+/**
+ * Creates the output file, replacing an existing one, and writes its header on the first process
+ * @param path path of the output file
+ * @return 0 if successful, nonzero otherwise
+ */
+int FrameWriter::open(std::string path) {
+    int status = MPI_File_open(this->comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                               &(this->file));
+    if (status != MPI_SUCCESS) {
+        if (this->rank == 0) {
+            std::cout << "error: failure to open \"" << path << "\" file!" << std::endl;
+        }
+        return 1;
+    }
+    MPI_File_set_size(this->file, 0);
+    this->is_open = true;
+
+    OutputHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "CATSOUTP", 8);
+    header.version = FrameWriter::VERSION;
+    header.num_lanes = this->inputs.num_lanes;
+    header.length = this->inputs.length;
+    header.periodic = this->inputs.periodic;
+    header.interval = this->inputs.output_interval;
+    header.block_size = this->inputs.output_block;
+    int header_bytes = (this->rank == 0) ? sizeof(OutputHeader) : 0;
+    MPI_File_write_at_all(this->file, 0, &header, header_bytes, MPI_BYTE, MPI_STATUS_IGNORE);
+    this->next_offset = sizeof(OutputHeader);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Gathers the first site and the number of sites of the segments of all the processes, which locate the segments on
+ * the Road and the chunks in the frames. Has to be called by all the processes whenever the segments are resized.
+ * @param segment_start the site of the Road at the start of the segment of the process
+ * @param segment_size number of sites in the segment of the process
+ * @return 0 if successful, nonzero otherwise
+ */
+int FrameWriter::setSegment(int segment_start, int segment_size) {
+    MPI_Allgather(&segment_start, 1, MPI_INT, this->segment_starts.data(), 1, MPI_INT, this->comm);
+    MPI_Allgather(&segment_size, 1, MPI_INT, this->segment_sizes.data(), 1, MPI_INT, this->comm);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Writes a frame with the occupancy and the aggregates of the segment. Only the Vehicles inside the segment are
+ * counted, the ghost Vehicles are counted by the processes that own them, and no Vehicles can be in flight to the
+ * neighbors. The write is started and left in flight until the buffer is needed again.
+ * @param step the step of the simulation
+ * @param road_ptr pointer to the Road of the segment
+ * @param vehicles pointer to the list of Vehicles in the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int FrameWriter::write(int step, Road* road_ptr, std::vector<Vehicle*>* vehicles) {
+    int segment_size = road_ptr->getLane(0)->getSize();
+    if (segment_size != this->segment_sizes[this->rank]) {
+        std::cerr << "error: the segment of rank " << this->rank << " was resized without the frame writer"
+                  << std::endl;
+        return 1;
+    }
+    int num_lanes = this->inputs.num_lanes;
+    int num_words = (segment_size + 63) / 64;
+    int block_size = this->inputs.output_block;
+    int num_blocks = (segment_size + block_size - 1) / block_size;
+
+    // The buffer was last used two frames ago, so that write has to be complete before the buffer is filled again
+    int b = this->num_frames % 2;
+    MPI_Wait(&(this->requests[b]), MPI_STATUS_IGNORE);
+    std::vector<unsigned char>* buffer = &(this->buffers[b]);
+
+    // The first process writes the header of the frame and the table of the segments before its chunk
+    long long table_bytes = sizeof(FrameHeader) + 2 * this->size * sizeof(int);
+    long long prefix = (this->rank == 0) ? table_bytes : 0;
+    buffer->resize(prefix + this->chunkBytes(segment_size));
+    unsigned char* data = buffer->data();
+    if (this->rank == 0) {
+        FrameHeader header = {step, this->size};
+        std::memcpy(data, &header, sizeof(FrameHeader));
+        for (int r = 0; r < this->size; r++) {
+            int entry[2] = {this->segment_starts[r], this->segment_sizes[r]};
+            std::memcpy(data + sizeof(FrameHeader) + r * sizeof(entry), entry, sizeof(entry));
+        }
+    }
+
+    // Pack the occupancy of the sites of every Lane, one Lane after the other
+    unsigned char* chunk = data + prefix;
+    this->words.resize(num_words);
+    for (int i = 0; i < num_lanes; i++) {
+        road_ptr->getLane(i)->packSites(0, segment_size, this->words.data());
+        std::memcpy(chunk + (size_t) i * num_words * sizeof(uint64_t), this->words.data(),
+                    num_words * sizeof(uint64_t));
+    }
+
+    // Count the Vehicles and sum their speeds in every block of sites, then turn the sums into the density in
+    // Vehicles per site, the average speed in sites per step and the flow in Vehicles per step per Lane
+    this->aggregates.assign(3 * num_blocks, 0.0f);
+    for (Vehicle* vehicle_ptr : *vehicles) {
+        int position = vehicle_ptr->getPrevPosition();
+        if (position >= 0 && position < segment_size) {
+            int k = position / block_size;
+            this->aggregates[3 * k] += 1.0f;
+            this->aggregates[3 * k + 1] += vehicle_ptr->getSpeed();
+        }
+    }
+    for (int k = 0; k < num_blocks; k++) {
+        float sites = (float) std::min(block_size, segment_size - k * block_size) * num_lanes;
+        float count = this->aggregates[3 * k];
+        float speed_sum = this->aggregates[3 * k + 1];
+        this->aggregates[3 * k] = count / sites;
+        this->aggregates[3 * k + 1] = (count > 0.0f) ? speed_sum / count : 0.0f;
+        this->aggregates[3 * k + 2] = speed_sum / sites;
+    }
+    std::memcpy(chunk + (size_t) num_lanes * num_words * sizeof(uint64_t), this->aggregates.data(),
+                this->aggregates.size() * sizeof(float));
+
+    // Locate the chunk of the segment after the chunks of the segments before it, and start the write
+    MPI_Offset offset = this->next_offset;
+    MPI_Offset frame_bytes = table_bytes;
+    for (int r = 0; r < this->size; r++) {
+        if (r == this->rank && r > 0) {
+            offset += frame_bytes;
+        }
+        frame_bytes += this->chunkBytes(this->segment_sizes[r]);
+    }
+    MPI_File_iwrite_at_all(this->file, offset, data, (int) buffer->size(), MPI_BYTE, &(this->requests[b]));
+    this->next_offset += frame_bytes;
+    this->num_frames++;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Completes the writes in flight and closes the output file
+ * @return 0 if successful, nonzero otherwise
+ */
+int FrameWriter::close() {
+    MPI_Waitall(2, this->requests, MPI_STATUSES_IGNORE);
+    MPI_File_close(&(this->file));
+    this->is_open = false;
+
+    // Return with no errors
+    return 0;
+}
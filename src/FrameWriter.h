@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_FRAMEWRITER_H
+#define CA_TRAFFIC_SIMULATION_FRAMEWRITER_H
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+
+#include "Inputs.h"
+#include "Road.h"
+#include "Vehicle.h"
+
+/**
+ * Header at the start of an output file, which describes the frames that follow it
+ */
+struct OutputHeader {
+    char magic[8];
+    int version;
+    int num_lanes;
+    int length;
+    int periodic;
+    int interval;
+    int block_size;
+};
+
+/**
+ * Header of a frame of an output file, followed by the start and the number of sites of every segment
+ */
+struct FrameHeader {
+    int step;
+    int num_segments;
+};
+
+/**
+ * Class for writing the state of the Road every output_interval steps to a single binary file, with nonblocking
+ * collective MPI-IO writes. Every frame has a chunk for the segment of every process, in the order of the segments,
+ * with the occupancy of the sites of every Lane as words of one bit per site and, for every block of output_block
+ * sites from the start of the segment, the density, the average speed and the flow of the Vehicles as floats. Each
+ * process fills one of two buffers while the write of the other one is in flight, so a write only has to complete when
+ * its buffer is needed again two frames later. The frames change size only when the segments are rebalanced, which
+ * all the processes do at the same step, so the processes locate the frames without communicating. The file is
+ * written in the native representation of the machine.
+ */
+class FrameWriter {
+private:
+    MPI_Comm comm;
+    int rank;
+    int size;
+    Inputs inputs;
+    MPI_File file;
+    bool is_open;
+    MPI_Offset next_offset;
+    int num_frames;
+    std::vector<int> segment_starts;
+    std::vector<int> segment_sizes;
+    std::vector<unsigned char> buffers[2];
+    MPI_Request requests[2];
+    std::vector<uint64_t> words;
+    std::vector<float> aggregates;
+    long long chunkBytes(int segment_size);
+public:
+    static constexpr int VERSION = 1;
+
+    FrameWriter(Inputs inputs, MPI_Comm comm);
+    ~FrameWriter();
+    int open(std::string path);
+    int setSegment(int segment_start, int segment_size);
+    int write(int step, Road* road_ptr, std::vector<Vehicle*>* vehicles);
+    int close();
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_FRAMEWRITER_H
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_GAPKERNEL_H
+#define CA_TRAFFIC_SIMULATION_GAPKERNEL_H
+
+#include <cstdint>
+
+/**
+ * Class with the kernels for searching an occupancy bitset, where bit i of word i / 64 is set if site i is occupied.
+ * The words of a bitset may be interleaved with the words of other bitsets, with a fixed stride between consecutive
+ * words of the same bitset. A search inspects a whole 64-bit word at a time, using the count trailing zeros and count
+ * leading zeros instructions when the compiler provides them (tzcnt and lzcnt with the BMI instruction sets), and a
+ * portable bit loop otherwise. The searches of a range fixed at compile time are unrolled to the one or two words that
+ * the range spans. The kernels are defined in the header so that they are inlined into the gap updates.
+ */
+class GapKernel {
+public:
+    /**
+     * Counts the trailing zero bits of a nonzero word
+     * @param word the word, must not be zero
+     * @return index of the lowest set bit
+     */
+    static inline int countTrailingZeros(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(word);
+#else
+        int n = 0;
+        while (!(word & 1)) {
+            word >>= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    /**
+     * Counts the leading zero bits of a nonzero word
+     * @param word the word, must not be zero
+     * @return 63 minus the index of the highest set bit
+     */
+    static inline int countLeadingZeros(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(word);
+#else
+        int n = 0;
+        while (!(word & (UINT64_C(1) << 63))) {
+            word <<= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    /**
+     * Locates the first set bit in a range of bits
+     * @param words the bitset
+     * @param stride number of words from one word of the bitset to the next
+     * @param first_bit first bit of the range
+     * @param last_bit last bit of the range, inclusive
+     * @return the first set bit, or last_bit + 1 if there is none
+     */
+    static inline int firstSet(const uint64_t* words, int stride, int first_bit, int last_bit) {
+        int w = first_bit >> 6;
+        uint64_t word = words[w * stride] & (~UINT64_C(0) << (first_bit & 63));
+        while (true) {
+            if (word) {
+                int bit = (w << 6) + countTrailingZeros(word);
+                return (bit <= last_bit) ? bit : last_bit + 1;
+            }
+            if (((w + 1) << 6) > last_bit) {
+                return last_bit + 1;
+            }
+            word = words[++w * stride];
+        }
+    }
+
+    /**
+     * Locates the last set bit in a range of bits
+     * @param words the bitset
+     * @param stride number of words from one word of the bitset to the next
+     * @param first_bit first bit of the range
+     * @param last_bit last bit of the range, inclusive
+     * @return the last set bit, or first_bit - 1 if there is none
+     */
+    static inline int lastSet(const uint64_t* words, int stride, int first_bit, int last_bit) {
+        int w = last_bit >> 6;
+        uint64_t word = words[w * stride] & (~UINT64_C(0) >> (63 - (last_bit & 63)));
+        while (true) {
+            if (word) {
+                int bit = (w << 6) + 63 - countLeadingZeros(word);
+                return (bit >= first_bit) ? bit : first_bit - 1;
+            }
+            if ((w << 6) <= first_bit) {
+                return first_bit - 1;
+            }
+            word = words[--w * stride];
+        }
+    }
+
+    /**
+     * Locates the first set bit in a range of REACH + 1 bits, a range no longer than a word so that it spans at most
+     * two words and the search has no loop
+     * @tparam REACH number of bits after the first bit of the range, less than 64
+     * @param words the bitset
+     * @param stride number of words from one word of the bitset to the next
+     * @param first_bit first bit of the range
+     * @return the first set bit, or first_bit + REACH + 1 if there is none
+     */
+    template <int REACH>
+    static inline int firstSetWithin(const uint64_t* words, int stride, int first_bit) {
+        static_assert(REACH >= 0 && REACH < 64, "the range of the search has to fit in a word");
+        int w = first_bit >> 6;
+        int shift = first_bit & 63;
+        uint64_t window = words[w * stride] >> shift;
+        if (shift + REACH > 63) {
+            window |= words[(w + 1) * stride] << (64 - shift);
+        }
+        window &= ~UINT64_C(0) >> (63 - REACH);
+        return window ? first_bit + countTrailingZeros(window) : first_bit + REACH + 1;
+    }
+
+    /**
+     * Locates the last set bit in a range of REACH + 1 bits, a range no longer than a word so that it spans at most two
+     * words and the search has no loop
+     * @tparam REACH number of bits before the last bit of the range, less than 64
+     * @param words the bitset
+     * @param stride number of words from one word of the bitset to the next
+     * @param last_bit last bit of the range, inclusive
+     * @return the last set bit, or last_bit - REACH - 1 if there is none
+     */
+    template <int REACH>
+    static inline int lastSetWithin(const uint64_t* words, int stride, int last_bit) {
+        static_assert(REACH >= 0 && REACH < 64, "the range of the search has to fit in a word");
+        int w = last_bit >> 6;
+        int shift = 63 - (last_bit & 63);
+        uint64_t window = words[w * stride] << shift;
+        if ((last_bit & 63) < REACH) {
+            window |= words[(w - 1) * stride] >> (64 - shift);
+        }
+        window &= ~UINT64_C(0) << (63 - REACH);
+        return window ? last_bit - countLeadingZeros(window) : last_bit - REACH - 1;
+    }
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_GAPKERNEL_H
@@ -0,0 +1,493 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+#include "HaloExchange.h"
+#include "Lane.h"
+
+/**
+ * Constructor for the HaloExchange
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @param comm Cartesian communicator of the segments of the Road
+ */
+HaloExchange::HaloExchange(Inputs inputs, MPI_Comm comm) {
+    // Determine the neighbors of the segment, which are null processes at the ends of an open Road
+    this->comm = comm;
+    MPI_Cart_shift(comm, 0, 1, &(this->neighbor_left), &(this->neighbor_right));
+
+    // A Vehicle that leaves a segment lands in one of the first max_speed sites of the next segment, so at most
+    // max_speed Vehicles per Lane can cross the boundary in one step
+    this->num_lanes = inputs.num_lanes;
+    this->halo_width = HaloExchange::width(inputs);
+    this->capacity = inputs.num_lanes * inputs.max_speed;
+
+    // Size the fields of the PackedVehicles, a crossing Vehicle lands within the first max_speed sites of the segment
+    this->lane_bits = HaloExchange::bitsFor(inputs.num_lanes - 1);
+    this->speed_bits = HaloExchange::bitsFor(inputs.max_speed);
+    this->position_bits = HaloExchange::bitsFor(inputs.max_speed - 1);
+    this->class_bits = HaloExchange::bitsFor(std::max((int) inputs.vehicle_classes.size() - 1, 0));
+    if (this->lane_bits + this->speed_bits + this->position_bits + this->class_bits > 32) {
+        std::cerr << "error: too many lanes, vehicle classes or too high a maximum speed to pack the vehicles"
+                  << std::endl;
+        MPI_Abort(comm, 1);
+    }
+
+    // Describe the messages to MPI, so that the count of a message is its number of Vehicles
+    HaloExchange::createVehicleType(&(this->vehicle_type));
+    MPI_Type_contiguous(3, MPI_UINT32_T, &(this->packed_type));
+    MPI_Type_commit(&(this->packed_type));
+
+    // Allocate the message buffers once for the whole simulation, with one bit per site in the halos
+    int halo_bytes = (this->num_lanes * this->halo_width + 7) / 8;
+    this->send_right.reserve(this->capacity);
+    this->recv_left.resize(this->capacity);
+    this->send_head.resize(halo_bytes);
+    this->send_tail.resize(halo_bytes);
+    this->recv_head.resize(halo_bytes);
+    this->recv_tail.resize(halo_bytes);
+
+    this->num_received = 0;
+
+    // At most one Vehicle per site of the ghost zones is sent in the exchange of the ghost Vehicles
+    this->ghost_capacity = this->num_lanes * std::max(HaloExchange::zoneBehind(inputs),
+                                                      HaloExchange::zoneAhead(inputs));
+    for (int side = 0; side < 2; side++) {
+        this->ghosts_send[side].reserve(this->ghost_capacity);
+        this->ghosts_recv[side].resize(this->ghost_capacity);
+        this->num_ghosts[side] = 0;
+    }
+    this->in_flight = false;
+    this->head_in_flight = false;
+    this->communication_time = 0.0;
+}
+
+/**
+ * Destructor for the HaloExchange, completes any exchange that is still in flight
+ */
+HaloExchange::~HaloExchange() {
+    if (this->in_flight) {
+        MPI_Waitall(6, this->requests, MPI_STATUSES_IGNORE);
+    }
+    if (this->head_in_flight) {
+        MPI_Waitall(2, this->head_requests, MPI_STATUSES_IGNORE);
+    }
+    MPI_Type_free(&(this->vehicle_type));
+    MPI_Type_free(&(this->packed_type));
+}
+
+/**
+ * Computes the number of bits needed to store the values from zero to a maximum value
+ * @param max_value the maximum value
+ * @return number of bits, at least one
+ */
+int HaloExchange::bitsFor(int max_value) {
+    int bits = 1;
+    while (bits < 32 && (max_value >> bits) != 0) {
+        bits++;
+    }
+    return bits;
+}
+
+/**
+ * Creates and commits the MPI datatype of a VehicleData, which has to be freed with MPI_Type_free
+ * @param type pointer to the datatype
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::createVehicleType(MPI_Datatype* type) {
+    int block_lengths[6] = {1, 1, 1, 1, 1, 1};
+    MPI_Aint displacements[6] = {
+        offsetof(VehicleData, lane),
+        offsetof(VehicleData, id),
+        offsetof(VehicleData, position),
+        offsetof(VehicleData, speed),
+        offsetof(VehicleData, time_on_road),
+        offsetof(VehicleData, vehicle_class)
+    };
+    MPI_Datatype types[6] = {MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT};
+    MPI_Datatype structure;
+    MPI_Type_create_struct(6, block_lengths, displacements, types, &structure);
+    MPI_Type_create_resized(structure, 0, sizeof(VehicleData), type);
+    MPI_Type_free(&structure);
+    MPI_Type_commit(type);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Packs a Vehicle that crosses the right edge of the segment, with the position relative to the start of the next
+ * segment
+ * @param vdata the Vehicle
+ * @return packed Vehicle
+ */
+PackedVehicle HaloExchange::pack(VehicleData vdata) {
+    PackedVehicle packed;
+    packed.id = (uint32_t) vdata.id;
+    packed.time_on_road = (uint32_t) vdata.time_on_road;
+    int class_shift = this->lane_bits + this->speed_bits;
+    packed.state = ((uint32_t) vdata.position << (class_shift + this->class_bits)) |
+                   ((uint32_t) vdata.vehicle_class << class_shift) | ((uint32_t) vdata.speed << this->lane_bits) |
+                   (uint32_t) vdata.lane;
+    return packed;
+}
+
+/**
+ * Unpacks a Vehicle that crossed the right edge of a segment
+ * @param packed the packed Vehicle
+ * @return the Vehicle, with the position relative to the start of the segment it crossed into
+ */
+VehicleData HaloExchange::unpack(PackedVehicle packed) {
+    VehicleData vdata;
+    vdata.lane = (int) (packed.state & ((UINT32_C(1) << this->lane_bits) - 1));
+    vdata.speed = (int) ((packed.state >> this->lane_bits) & ((UINT32_C(1) << this->speed_bits) - 1));
+    int class_shift = this->lane_bits + this->speed_bits;
+    vdata.vehicle_class = (int) ((packed.state >> class_shift) & ((UINT32_C(1) << this->class_bits) - 1));
+    vdata.position = (int) (packed.state >> (class_shift + this->class_bits));
+    vdata.id = (int) packed.id;
+    vdata.time_on_road = (int) packed.time_on_road;
+    return vdata;
+}
+
+/**
+ * Computes the number of sites next to a boundary that a Vehicle can see across the boundary. The forward gap in the
+ * other Lane is probed up to max_speed + 2 sites ahead, and the backward gap up to look_other_backward + 1 sites
+ * behind.
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @return width of the boundary region in sites
+ */
+int HaloExchange::width(const Inputs& inputs) {
+    return std::max(inputs.max_speed + 2, inputs.look_other_backward + 1);
+}
+
+/**
+ * Computes the width of the ghost zone behind the segment, in which the Vehicles of the left neighbor are updated along
+ * with the Vehicles of the segment when the Vehicles are only exchanged every exchange_interval steps
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @return width of the ghost zone in sites, zero if Vehicles are not exchanged
+ */
+int HaloExchange::zoneBehind(const Inputs& inputs) {
+    if (inputs.exchange_interval <= 1) {
+        return 0;
+    }
+    return inputs.exchange_interval * (inputs.max_speed + inputs.look_other_backward + 1);
+}
+
+/**
+ * Computes the width of the ghost zone ahead of the segment, in which the Vehicles of the right neighbor are updated
+ * along with the Vehicles of the segment when the Vehicles are only exchanged every exchange_interval steps
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @return width of the ghost zone in sites, zero if Vehicles are not exchanged
+ */
+int HaloExchange::zoneAhead(const Inputs& inputs) {
+    if (inputs.exchange_interval <= 1) {
+        return 0;
+    }
+    return inputs.exchange_interval * (2 * inputs.max_speed + 3);
+}
+
+/**
+ * Computes the number of ghost sites on each side of the Lanes, which holds the ghost zones and the sites that the
+ * Vehicles at the edges of the ghost zones can see
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @return number of ghost sites on each side
+ */
+int HaloExchange::ghostWidth(const Inputs& inputs) {
+    return HaloExchange::width(inputs) + std::max(HaloExchange::zoneBehind(inputs), HaloExchange::zoneAhead(inputs));
+}
+
+/**
+ * Computes the smallest number of sites of a segment, so that Vehicles only see into the neighboring segments and the
+ * ghost zones only cover the neighboring segments
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @return smallest number of sites of a segment
+ */
+int HaloExchange::minSegmentSize(const Inputs& inputs) {
+    return std::max(HaloExchange::width(inputs),
+                    std::max(HaloExchange::zoneBehind(inputs), HaloExchange::zoneAhead(inputs)));
+}
+
+/**
+ * Checks if the segment has a neighbor on the right, or if it is the last segment of the Road
+ * @return whether or not there is a segment to the right
+ */
+bool HaloExchange::hasRightNeighbor() {
+    return this->neighbor_right != MPI_PROC_NULL;
+}
+
+/**
+ * Adds a Vehicle that left the right edge of the segment to the message for the right neighbor
+ * @param vdata packed Vehicle, with the position relative to the start of the next segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::pushOutgoing(VehicleData vdata) {
+    if ((int) this->send_right.size() >= this->capacity) {
+        return 1;
+    }
+    this->send_right.push_back(this->pack(vdata));
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Packs the occupancy of halo_width consecutive sites of every Lane into a bit buffer
+ * @param lanes pointer to the Lanes of the segment
+ * @param first_site first site of the halo in the Lanes
+ * @param buffer pointer to the bit buffer
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::packSites(std::vector<Lane*>* lanes, int first_site, std::vector<unsigned char>* buffer) {
+    std::fill(buffer->begin(), buffer->end(), 0);
+    for (int i = 0; i < this->num_lanes; i++) {
+        for (int k = 0; k < this->halo_width; k++) {
+            if ((*lanes)[i]->hasVehicleInSite(first_site + k)) {
+                int bit = i * this->halo_width + k;
+                (*buffer)[bit / 8] |= (unsigned char) (1 << (bit % 8));
+            }
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Unpacks a bit buffer into halo_width consecutive ghost sites of every Lane
+ * @param lanes pointer to the Lanes of the segment
+ * @param first_site first ghost site of the halo in the Lanes
+ * @param buffer pointer to the bit buffer
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::unpackSites(std::vector<Lane*>* lanes, int first_site, std::vector<unsigned char>* buffer) {
+    for (int i = 0; i < this->num_lanes; i++) {
+        for (int k = 0; k < this->halo_width; k++) {
+            int bit = i * this->halo_width + k;
+            (*lanes)[i]->setGhostSite(first_site + k, ((*buffer)[bit / 8] >> (bit % 8)) & 1);
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Packs the halos of the segment and starts the nonblocking exchange with both neighbors
+ * @param lanes pointer to the Lanes of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::post(std::vector<Lane*>* lanes) {
+    int size = (*lanes)[0]->getSize();
+    this->packSites(lanes, 0, &(this->send_head));
+    this->packSites(lanes, size - this->halo_width, &(this->send_tail));
+
+    // Reset the halo receive buffers, since nothing is received from a null process at the ends of the Road
+    std::fill(this->recv_head.begin(), this->recv_head.end(), 0);
+    std::fill(this->recv_tail.begin(), this->recv_tail.end(), 0);
+
+    int halo_bytes = this->send_head.size();
+    double start_time = MPI_Wtime();
+    MPI_Irecv(this->recv_left.data(), this->capacity, this->packed_type, this->neighbor_left, 0, this->comm,
+              &(this->requests[0]));
+    MPI_Irecv(this->recv_tail.data(), halo_bytes, MPI_BYTE, this->neighbor_left, 1, this->comm,
+              &(this->requests[1]));
+    MPI_Irecv(this->recv_head.data(), halo_bytes, MPI_BYTE, this->neighbor_right, 2, this->comm,
+              &(this->requests[2]));
+    MPI_Isend(this->send_right.data(), this->send_right.size(), this->packed_type, this->neighbor_right, 0,
+              this->comm, &(this->requests[3]));
+    MPI_Isend(this->send_tail.data(), halo_bytes, MPI_BYTE, this->neighbor_right, 1, this->comm,
+              &(this->requests[4]));
+    MPI_Isend(this->send_head.data(), halo_bytes, MPI_BYTE, this->neighbor_left, 2, this->comm,
+              &(this->requests[5]));
+    this->in_flight = true;
+    this->communication_time += MPI_Wtime() - start_time;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Completes the exchange started by post and fills the ghost sites of the Lanes. Afterwards, the incoming Vehicles are
+ * available to be placed in the Lanes.
+ * @param lanes pointer to the Lanes of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::wait(std::vector<Lane*>* lanes) {
+    if (!this->in_flight) {
+        return 1;
+    }
+
+    MPI_Status statuses[6];
+    double start_time = MPI_Wtime();
+    MPI_Waitall(6, this->requests, statuses);
+    this->in_flight = false;
+    this->communication_time += MPI_Wtime() - start_time;
+
+    int count;
+    MPI_Get_count(&(statuses[0]), this->packed_type, &count);
+    this->num_received = count;
+
+    // Fill the ghost sites with the last sites of the left neighbor and the first sites of the right neighbor
+    int size = (*lanes)[0]->getSize();
+    this->unpackSites(lanes, -this->halo_width, &(this->recv_tail));
+    this->unpackSites(lanes, size, &(this->recv_head));
+
+    // The right neighbor packed its halo before it received the Vehicles sent to it, so add them to the ghost sites
+    for (int n = 0; n < (int) this->send_right.size(); n++) {
+        VehicleData vdata = this->unpack(this->send_right[n]);
+        (*lanes)[vdata.lane]->setGhostSite(size + vdata.position, true);
+    }
+
+    // The send buffer for the Vehicles can be reused now
+    this->send_right.clear();
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Packs the first sites of the segment and starts sending them to the left neighbor, after the synchronous lane
+ * switch step. The exchange started by post must have been completed.
+ * @param lanes pointer to the Lanes of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::postHead(std::vector<Lane*>* lanes) {
+    if (this->in_flight) {
+        return 1;
+    }
+    this->packSites(lanes, 0, &(this->send_head));
+    std::fill(this->recv_head.begin(), this->recv_head.end(), 0);
+
+    int halo_bytes = this->send_head.size();
+    double start_time = MPI_Wtime();
+    MPI_Irecv(this->recv_head.data(), halo_bytes, MPI_BYTE, this->neighbor_right, 3, this->comm,
+              &(this->head_requests[0]));
+    MPI_Isend(this->send_head.data(), halo_bytes, MPI_BYTE, this->neighbor_left, 3, this->comm,
+              &(this->head_requests[1]));
+    this->head_in_flight = true;
+    this->communication_time += MPI_Wtime() - start_time;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Completes the exchange started by postHead and fills the ghost sites past the end of the Lanes. The right neighbor
+ * already holds the Vehicles sent to it, so nothing is added to the ghost sites.
+ * @param lanes pointer to the Lanes of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::waitHead(std::vector<Lane*>* lanes) {
+    if (!this->head_in_flight) {
+        return 1;
+    }
+    double start_time = MPI_Wtime();
+    MPI_Waitall(2, this->head_requests, MPI_STATUSES_IGNORE);
+    this->head_in_flight = false;
+    this->communication_time += MPI_Wtime() - start_time;
+    this->unpackSites(lanes, (*lanes)[0]->getSize(), &(this->recv_head));
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the number of Vehicles received from the left neighbor
+ * @return number of incoming Vehicles
+ */
+int HaloExchange::getNumIncoming() {
+    return this->num_received;
+}
+
+/**
+ * Getter for a Vehicle received from the left neighbor
+ * @param n index of the incoming Vehicle
+ * @return packed Vehicle, with the position relative to the start of this segment
+ */
+VehicleData HaloExchange::getIncoming(int n) {
+    return this->unpack(this->recv_left[n]);
+}
+
+/**
+ * Adds a copy of a Vehicle of the segment to the ghost Vehicles for a neighbor
+ * @param side the side of the neighbor
+ * @param vdata packed Vehicle, with the position relative to the start of the segment of the neighbor
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::pushGhost(Side side, VehicleData vdata) {
+    if ((int) this->ghosts_send[side].size() >= this->ghost_capacity) {
+        return 1;
+    }
+    this->ghosts_send[side].push_back(vdata);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Exchanges the ghost Vehicles with both neighbors. Afterwards, the ghost Vehicles of the neighbors are available to
+ * be placed in the ghost zones.
+ * @return 0 if successful, nonzero otherwise
+ */
+int HaloExchange::exchangeGhosts() {
+    MPI_Status status;
+    int count;
+
+    // Nothing is received from a null process at the ends of the Road
+    this->num_ghosts[LEFT] = 0;
+    this->num_ghosts[RIGHT] = 0;
+
+    double start_time = MPI_Wtime();
+    MPI_Sendrecv(this->ghosts_send[RIGHT].data(), this->ghosts_send[RIGHT].size(), this->vehicle_type,
+                 this->neighbor_right, 8, this->ghosts_recv[LEFT].data(), this->ghost_capacity, this->vehicle_type,
+                 this->neighbor_left, 8, this->comm, &status);
+    if (this->neighbor_left != MPI_PROC_NULL) {
+        MPI_Get_count(&status, this->vehicle_type, &count);
+        this->num_ghosts[LEFT] = count;
+    }
+    MPI_Sendrecv(this->ghosts_send[LEFT].data(), this->ghosts_send[LEFT].size(), this->vehicle_type,
+                 this->neighbor_left, 9, this->ghosts_recv[RIGHT].data(), this->ghost_capacity, this->vehicle_type,
+                 this->neighbor_right, 9, this->comm, &status);
+    if (this->neighbor_right != MPI_PROC_NULL) {
+        MPI_Get_count(&status, this->vehicle_type, &count);
+        this->num_ghosts[RIGHT] = count;
+    }
+    this->communication_time += MPI_Wtime() - start_time;
+
+    // The send buffers can be reused now
+    this->ghosts_send[LEFT].clear();
+    this->ghosts_send[RIGHT].clear();
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the number of ghost Vehicles received from a neighbor
+ * @param side the side of the neighbor
+ * @return number of ghost Vehicles
+ */
+int HaloExchange::getNumGhosts(Side side) {
+    return this->num_ghosts[side];
+}
+
+/**
+ * Getter for a ghost Vehicle received from a neighbor
+ * @param side the side of the neighbor
+ * @param n index of the ghost Vehicle
+ * @return packed Vehicle, with the position relative to the start of this segment
+ */
+VehicleData HaloExchange::getGhost(Side side, int n) {
+    return this->ghosts_recv[side][n];
+}
+
+/**
+ * Getter for the total time spent in the communication with the neighbors, including the time spent waiting for them
+ * @return communication time in seconds
+ */
+double HaloExchange::getCommunicationTime() {
+    return this->communication_time;
+}
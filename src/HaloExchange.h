@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_HALOEXCHANGE_H
+#define CA_TRAFFIC_SIMULATION_HALOEXCHANGE_H
+
+#include <vector>
+#include <cstdint>
+#include <mpi.h>
+
+#include "Inputs.h"
+
+// Forward Declarations
+class Lane;
+
+/**
+ * Packed form of a Vehicle that crosses the boundary between two road segments
+ */
+struct VehicleData {
+    int lane;
+    int id;
+    int position;
+    int speed;
+    int time_on_road;
+    int vehicle_class;
+};
+
+/**
+ * Compact form of a Vehicle that crosses the right edge of a segment in a step. A crossing Vehicle lands in one of the
+ * first max_speed sites of the next segment, so its Lane, speed, position and class share one word with just enough
+ * bits for each.
+ */
+struct PackedVehicle {
+    uint32_t id;
+    uint32_t time_on_road;
+    uint32_t state;
+};
+
+/**
+ * Class for the nonblocking exchange of boundary information between the ranks that own neighboring segments of the
+ * Road. Vehicles leaving the right edge of a segment are sent to the right neighbor as PackedVehicles, and the
+ * occupancy of the first and last sites of every Lane is sent as a bit-packed halo to the left and right neighbor,
+ * where it fills the ghost sites of the Lanes. The exchange is posted at the end of a step and completed during the
+ * next step, so that it overlaps with the update of the interior Vehicles. For the synchronous update, the first sites
+ * are exchanged once more between the lane switch and the lane move step.
+ *
+ * With an exchange interval of k steps, the synchronous update exchanges Vehicles instead of occupancy. The Lanes have
+ * ghost zones of k times the distance that the state of a Vehicle can depend on in one step, and every k steps each
+ * process sends copies of the Vehicles near its boundaries to the neighbors, which update these ghost Vehicles along
+ * with their own. The state of a Vehicle only depends on Vehicles within max_speed + look_other_backward + 1 sites
+ * behind it and 2 * max_speed + 3 sites ahead of it from one step to the next, through the lane changes of the Vehicles
+ * ahead of it, so the Vehicles of the segment are still exact after k steps.
+ */
+class HaloExchange {
+private:
+    MPI_Comm comm;
+    int neighbor_left;
+    int neighbor_right;
+    int num_lanes;
+    int halo_width;
+    int capacity;
+    int lane_bits;
+    int speed_bits;
+    int position_bits;
+    int class_bits;
+    MPI_Datatype vehicle_type;
+    MPI_Datatype packed_type;
+    std::vector<PackedVehicle> send_right;
+    std::vector<PackedVehicle> recv_left;
+    std::vector<unsigned char> send_head;
+    std::vector<unsigned char> send_tail;
+    std::vector<unsigned char> recv_head;
+    std::vector<unsigned char> recv_tail;
+    int num_received;
+    int ghost_capacity;
+    std::vector<VehicleData> ghosts_send[2];
+    std::vector<VehicleData> ghosts_recv[2];
+    int num_ghosts[2];
+    MPI_Request requests[6];
+    MPI_Request head_requests[2];
+    bool in_flight;
+    bool head_in_flight;
+    double communication_time;
+    PackedVehicle pack(VehicleData vdata);
+    VehicleData unpack(PackedVehicle packed);
+    int packSites(std::vector<Lane*>* lanes, int first_site, std::vector<unsigned char>* buffer);
+    int unpackSites(std::vector<Lane*>* lanes, int first_site, std::vector<unsigned char>* buffer);
+public:
+    /**
+     * Sides of the segment
+     */
+    enum Side {
+        LEFT = 0,
+        RIGHT = 1
+    };
+
+    HaloExchange(Inputs inputs, MPI_Comm comm);
+    ~HaloExchange();
+    static int width(const Inputs& inputs);
+    static int bitsFor(int max_value);
+    static int createVehicleType(MPI_Datatype* type);
+    static int zoneBehind(const Inputs& inputs);
+    static int zoneAhead(const Inputs& inputs);
+    static int ghostWidth(const Inputs& inputs);
+    static int minSegmentSize(const Inputs& inputs);
+    bool hasRightNeighbor();
+    int pushOutgoing(VehicleData vdata);
+    int post(std::vector<Lane*>* lanes);
+    int wait(std::vector<Lane*>* lanes);
+    int postHead(std::vector<Lane*>* lanes);
+    int waitHead(std::vector<Lane*>* lanes);
+    int getNumIncoming();
+    VehicleData getIncoming(int n);
+    int pushGhost(Side side, VehicleData vdata);
+    int exchangeGhosts();
+    int getNumGhosts(Side side);
+    VehicleData getGhost(Side side, int n);
+    double getCommunicationTime();
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_HALOEXCHANGE_H
@@ -6,8 +6,84 @@
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <algorithm>
+#include <stdexcept>
 
 #include "Inputs.h"
+#include "CDF.h"
+
+/**
+ * Structure for an integer input, with its name in the input file and its member of the Inputs
+ */
+struct IntKey {
+    const char* name;
+    int Inputs::* field;
+};
+
+/**
+ * Structure for a floating point input, with its name in the input file and its member of the Inputs
+ */
+struct DoubleKey {
+    const char* name;
+    double Inputs::* field;
+};
+
+/**
+ * Structure for a text input, with its name in the input file and its member of the Inputs
+ */
+struct StringKey {
+    const char* name;
+    std::string Inputs::* field;
+};
+
+static const IntKey INT_KEYS[] = {
+    {"num_lanes", &Inputs::num_lanes},
+    {"length", &Inputs::length},
+    {"max_speed", &Inputs::max_speed},
+    {"look_forward", &Inputs::look_forward},
+    {"look_other_forward", &Inputs::look_other_forward},
+    {"look_other_backward", &Inputs::look_other_backward},
+    {"max_time", &Inputs::max_time},
+    {"warmup_time", &Inputs::warmup_time},
+    {"synchronous", &Inputs::synchronous},
+    {"balance_interval", &Inputs::balance_interval},
+    {"cdf_sampler", &Inputs::cdf_sampler},
+    {"quantiles", &Inputs::quantiles},
+    {"exchange_interval", &Inputs::exchange_interval},
+    {"periodic", &Inputs::periodic},
+    {"checkpoint_interval", &Inputs::checkpoint_interval},
+    {"restart", &Inputs::restart},
+    {"output_interval", &Inputs::output_interval},
+    {"output_block", &Inputs::output_block},
+    {"detector_interval", &Inputs::detector_interval},
+    {"detector_spacing", &Inputs::detector_spacing},
+    {"device", &Inputs::device}
+};
+
+static const DoubleKey DOUBLE_KEYS[] = {
+    {"percent_full", &Inputs::percent_full},
+    {"prob_slow_down", &Inputs::prob_slow_down},
+    {"prob_change", &Inputs::prob_change},
+    {"step_size", &Inputs::step_size}
+};
+
+static const StringKey STRING_KEYS[] = {
+    {"classes_path", &Inputs::classes_path},
+    {"network_path", &Inputs::network_path},
+    {"cdf_path", &Inputs::cdf_path}
+};
+
+/**
+ * Names of the inputs in the order of the lines of a positional input file, the first Inputs::NUM_REQUIRED of which
+ * have no default
+ */
+static const char* POSITIONAL_KEYS[] = {
+    "num_lanes", "length", "max_speed", "look_forward", "look_other_forward", "look_other_backward",
+    "prob_slow_down", "prob_change", "max_time", "step_size", "warmup_time", "synchronous", "balance_interval",
+    "cdf_sampler", "quantiles", "exchange_interval", "periodic", "percent_full", "checkpoint_interval", "restart",
+    "output_interval", "output_block", "classes_path", "network_path", "detector_interval", "detector_spacing",
+    "device"
+};
 
 /**
  * Helper function to parse a line in the input file and return the parameter value of the line
@@ -19,17 +95,121 @@ std::string parseLine(std::string line) {
 }
 
 /**
- * Loads the inputs options from a text file into the class variables
+ * Helper function to remove the spaces and tabs at both ends of a string
+ * @param text the string
+ * @return the string without spaces and tabs at its ends
+ */
+std::string trim(std::string text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) {
+        return "";
+    }
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+/**
+ * Constructor for the Inputs, with the defaults of the inputs that can be left out of the input file
+ */
+Inputs::Inputs() {
+    this->num_lanes = 0;
+    this->length = 0;
+    this->percent_full = 0.0;
+    this->max_speed = 0;
+    this->look_forward = 0;
+    this->look_other_forward = 0;
+    this->look_other_backward = 0;
+    this->prob_slow_down = 0.0;
+    this->prob_change = 0.0;
+    this->max_time = 0;
+    this->step_size = 0.0;
+    this->warmup_time = 0;
+    this->synchronous = 0;
+    this->balance_interval = 0;
+    this->cdf_sampler = 0;
+    this->quantiles = 0;
+    this->exchange_interval = 1;
+    this->periodic = 0;
+    this->checkpoint_interval = 0;
+    this->restart = 0;
+    this->output_interval = 0;
+    this->output_block = 64;
+    this->detector_interval = 0;
+    this->detector_spacing = 1000;
+    this->device = 0;
+    this->classes_path = "";
+    this->network_path = "";
+    this->cdf_path = "interarrival-cdf.dat";
+    this->seed = 0;
+    this->replica = -1;
+}
+
+/**
+ * Loads the inputs on the first process of a communicator and broadcasts them to the other processes. The first
+ * process reads the input file, applies the overrides from the command line, checks the inputs and reads the file of
+ * Vehicle classes and the CDF of interarrival times, so no other process opens a file. Has to be called by all the
+ * processes of the communicator.
+ * @param path path of the input file
+ * @param overrides inputs that override the input file, as key=value
+ * @param comm communicator of the processes that need the inputs
+ * @return 0 if successful, nonzero otherwise, the same on every process
+ */
+int Inputs::load(std::string path, std::vector<std::string> overrides, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    int status = 0;
+    if (rank == 0) {
+        std::vector<std::string> keys;
+        status = this->loadFromFile(path, &keys);
+        for (int k = 0; status == 0 && k < (int) overrides.size(); k++) {
+            size_t equals = overrides[k].find('=');
+            std::string key = trim(overrides[k].substr(0, equals));
+            status = this->set(key, trim(overrides[k].substr(equals + 1)));
+            keys.push_back(key);
+        }
+        for (int k = 0; status == 0 && k < Inputs::NUM_REQUIRED; k++) {
+            if (std::find(keys.begin(), keys.end(), POSITIONAL_KEYS[k]) == keys.end()) {
+                std::cout << "error: missing input " << POSITIONAL_KEYS[k] << " in \"" << path << "\" file!"
+                          << std::endl;
+                status = 1;
+            }
+        }
+        if (status == 0) {
+            status = this->validate();
+        }
+
+        // Without a file of Vehicle classes, all the Vehicles are in one class with the parameters of the inputs
+        this->vehicle_classes.clear();
+        if (status == 0 && !this->classes_path.empty()) {
+            status = this->loadVehicleClasses(this->classes_path);
+        }
+        if (status == 0) {
+            status = this->loadCDF();
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, comm);
+    if (status != 0) {
+        return status;
+    }
+    return this->broadcast(comm, 0);
+}
+
+/**
+ * Loads the inputs from a text file into the class variables. A file with an = on its first line that is not empty
+ * has one input per line as key = value, where # starts a comment. Any other file has the inputs in the order of the
+ * positional input file, one per line followed by an optional description, up to the first empty line.
+ * @param path path of the input file
+ * @param keys pointer to the list to add the names of the inputs in the file to
  * @return 0 if successful, nonzero otherwise
  */
-int Inputs::loadFromFile() {
+int Inputs::loadFromFile(std::string path, std::vector<std::string>* keys) {
     // Open the input file for reading the simulation inputs
     std::fstream input_file;
-    input_file.open("cats-input.txt", std::fstream::in);
+    input_file.open(path, std::fstream::in);
 
     // Check of the input file was loaded properly
     if (!input_file) {
-        std::cout << "error: failure to open \"cats-input.txt\" file!" << std::endl;
+        std::cout << "error: failure to open \"" << path << "\" file!" << std::endl;
         return 1;
     }
 
@@ -41,23 +221,393 @@ int Inputs::loadFromFile() {
         input_lines.push_back(line);
     }
 
-    // Parse each line of the input file into the variable it corresponds to
-    int n = 0;
-    this->num_lanes           = std::stoi(parseLine(input_lines[n++]));
-    this->length              = std::stoi(parseLine(input_lines[n++]));
-    this->max_speed           = std::stoi(parseLine(input_lines[n++]));
-    this->look_forward        = std::stoi(parseLine(input_lines[n++]));
-    this->look_other_forward  = std::stoi(parseLine(input_lines[n++]));
-    this->look_other_backward = std::stoi(parseLine(input_lines[n++]));
-    this->prob_slow_down      = std::stod(parseLine(input_lines[n++]));
-    this->prob_change         = std::stod(parseLine(input_lines[n++]));
-    this->max_time            = std::stoi(parseLine(input_lines[n++]));
-    this->step_size           = std::stod(parseLine(input_lines[n++]));
-    this->warmup_time         = std::stoi(parseLine(input_lines[n++]));
-
     // Close the input file
     input_file.close();
 
+    // Find the format of the file from its first line that is not empty
+    bool named = false;
+    for (std::string input_line : input_lines) {
+        std::string content = trim(input_line.substr(0, input_line.find('#')));
+        if (!content.empty()) {
+            named = content.find('=') != std::string::npos;
+            break;
+        }
+    }
+
+    // Parse each line of the input file into the variable it corresponds to
+    int num_positional = sizeof(POSITIONAL_KEYS) / sizeof(POSITIONAL_KEYS[0]);
+    for (int n = 0; n < (int) input_lines.size(); n++) {
+        std::string key;
+        std::string value;
+        if (named) {
+            std::string content = trim(input_lines[n].substr(0, input_lines[n].find('#')));
+            if (content.empty()) {
+                continue;
+            }
+            size_t equals = content.find('=');
+            if (equals == std::string::npos) {
+                std::cout << "error: missing = on line " << n + 1 << " of \"" << path << "\" file!" << std::endl;
+                return 1;
+            }
+            key = trim(content.substr(0, equals));
+            value = trim(content.substr(equals + 1));
+        } else {
+            // The optional lines keep their defaults if they are missing
+            value = parseLine(input_lines[n]);
+            if (n >= num_positional || value.empty()) {
+                break;
+            }
+            key = POSITIONAL_KEYS[n];
+        }
+        if (this->set(key, value) != 0) {
+            return 1;
+        }
+        keys->push_back(key);
+    }
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Sets an input from its name and its value as text
+ * @param key name of the input
+ * @param value value of the input
+ * @return 0 if successful, nonzero otherwise
+ */
+int Inputs::set(std::string key, std::string value) {
+    for (StringKey string_key : STRING_KEYS) {
+        if (key == string_key.name) {
+            this->*(string_key.field) = value;
+            return 0;
+        }
+    }
+
+    // A number has to take up the whole value
+    for (IntKey int_key : INT_KEYS) {
+        if (key == int_key.name) {
+            if (!Inputs::parseNumber(value, &(this->*(int_key.field)))) {
+                std::cout << "error: invalid value \"" << value << "\" of input " << key << "!" << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+    }
+    for (DoubleKey double_key : DOUBLE_KEYS) {
+        if (key == double_key.name) {
+            if (!Inputs::parseNumber(value, &(this->*(double_key.field)))) {
+                std::cout << "error: invalid value \"" << value << "\" of input " << key << "!" << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+    }
+    std::cout << "error: unknown input " << key << "!" << std::endl;
+    return 1;
+}
+
+/**
+ * Parses an integer that has to take up the whole text, as the numbers of the input files are parsed
+ * @param text the text of the number
+ * @param value_ptr pointer to the number, set if the text is valid
+ * @return true if the text is a valid integer, false otherwise
+ */
+bool Inputs::parseNumber(std::string text, int* value_ptr) {
+    try {
+        size_t end = 0;
+        int value = std::stoi(text, &end);
+        if (end != text.size()) {
+            return false;
+        }
+        *value_ptr = value;
+    } catch (std::exception& exception) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parses a floating point number that has to take up the whole text, as the numbers of the input files are parsed
+ * @param text the text of the number
+ * @param value_ptr pointer to the number, set if the text is valid
+ * @return true if the text is a valid floating point number, false otherwise
+ */
+bool Inputs::parseNumber(std::string text, double* value_ptr) {
+    try {
+        size_t end = 0;
+        double value = std::stod(text, &end);
+        if (end != text.size()) {
+            return false;
+        }
+        *value_ptr = value;
+    } catch (std::exception& exception) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Checks that the inputs are consistent
+ * @return 0 if successful, nonzero otherwise
+ */
+int Inputs::validate() {
+    // The Road needs at least one Lane, the Vehicles change to the Lanes on both sides of them
+    if (this->num_lanes < 1) {
+        std::cout << "error: the road needs at least one lane!" << std::endl;
+        return 1;
+    }
+
+    // The segments and the ghost sites are sized from the length and the maximum speed, and the interarrival times
+    // are converted to steps with the step size
+    if (this->length < 1 || this->max_speed < 1 || this->step_size <= 0.0) {
+        std::cout << "error: the length, the maximum speed and the step size have to be above 0!" << std::endl;
+        return 1;
+    }
+
+    // The Vehicles look ahead and behind them for the gaps, which also sets the width of the ghost sites
+    if (this->look_forward < 0 || this->look_other_forward < 0 || this->look_other_backward < 0) {
+        std::cout << "error: the look ahead and look behind distances can not be negative!" << std::endl;
+        return 1;
+    }
+
+    // The Vehicles slow down and change lanes with these probabilities
+    if (this->prob_slow_down < 0.0 || this->prob_slow_down > 1.0 || this->prob_change < 0.0 ||
+        this->prob_change > 1.0) {
+        std::cout << "error: the probabilities of slowing down and changing lanes have to be between 0 and 1!"
+                  << std::endl;
+        return 1;
+    }
+
+    // The simulation runs for max_time steps, of which the first warmup_time steps are not measured
+    if (this->max_time < 0 || this->warmup_time < 0) {
+        std::cout << "error: the number of steps and the warm-up time can not be negative!" << std::endl;
+        return 1;
+    }
+
+    // The segments are rebalanced every balance_interval steps, or never if it is zero, and the Vehicles are exchanged
+    // every exchange_interval steps
+    if (this->balance_interval < 0) {
+        std::cout << "error: the balance interval can not be negative!" << std::endl;
+        return 1;
+    }
+    if (this->exchange_interval < 1) {
+        std::cout << "error: the exchange interval has to be at least 1!" << std::endl;
+        return 1;
+    }
+
+    // Updating the ghost Vehicles only gives the same result as their own process with the synchronous update
+    if (this->exchange_interval > 1 && !this->synchronous) {
+        std::cout << "error: an exchange interval above 1 requires the synchronous update!" << std::endl;
+        return 1;
+    }
+
+    // The Vehicles of a ring are all placed at the start, with the percentage of the sites given by percent_full
+    if (this->periodic && (this->percent_full <= 0.0 || this->percent_full > 100.0)) {
+        std::cout << "error: a periodic road needs a percent full between 0 and 100!" << std::endl;
+        return 1;
+    }
+
+    // A checkpoint is written every checkpoint_interval steps, or never if it is zero
+    if (this->checkpoint_interval < 0) {
+        std::cout << "error: the checkpoint interval can not be negative!" << std::endl;
+        return 1;
+    }
+
+    // The state of the Road is written every output_interval steps, or never if it is zero, with aggregates over
+    // blocks of output_block sites
+    if (this->output_interval < 0 || this->output_block < 1) {
+        std::cout << "error: the output needs an interval of at least 0 and a block of at least 1 site!" << std::endl;
+        return 1;
+    }
+
+    // The detectors are reduced every detector_interval steps, or never if it is zero, and are detector_spacing sites
+    // apart
+    if (this->detector_interval < 0 || this->detector_spacing < 1) {
+        std::cout << "error: the detectors need an interval of at least 0 and a spacing of at least 1 site!"
+                  << std::endl;
+        return 1;
+    }
+
+    // The device engine updates a ring between the exchanges of the ghost Vehicles, without the detectors
+    if (this->device != 0 && this->device != 1) {
+        std::cout << "error: the device input has to be 0 or 1!" << std::endl;
+        return 1;
+    }
+    if (this->device && (this->exchange_interval < 2 || !this->periodic || this->detector_interval > 0)) {
+        std::cout << "error: the device engine requires an exchange interval above 1 on a periodic road without "
+                  << "detectors!" << std::endl;
+        return 1;
+    }
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Loads the classes of the Vehicles from a text file with one class per line, with the fraction of the spawned
+ * Vehicles in the class, the maximum speed, the slow down probability and the lane change probability, separated by
+ * spaces. Empty lines and lines that start with # are skipped. The fractions are normalized to sum to one, and the
+ * maximum speed of a class can not be above the maximum speed of the input file, which sizes the exchanges.
+ * @param path path of the file of Vehicle classes
+ * @return 0 if successful, nonzero otherwise
+ */
+int Inputs::loadVehicleClasses(std::string path) {
+    std::ifstream classes_file(path);
+    if (!classes_file) {
+        std::cout << "error: failure to open \"" << path << "\" file!" << std::endl;
+        return 1;
+    }
+
+    std::string line;
+    double total = 0.0;
+    while (std::getline(classes_file, line)) {
+        std::stringstream stream(line);
+        VehicleClass vehicle_class;
+        std::string fields[4];
+        if (!(stream >> fields[0]) || fields[0][0] == '#') {
+            continue;
+        }
+        if (!(stream >> fields[1] >> fields[2] >> fields[3])) {
+            std::cout << "error: missing parameters of the vehicle class in \"" << line << "\"!" << std::endl;
+            return 1;
+        }
+        if (!Inputs::parseNumber(fields[0], &(vehicle_class.fraction))
+            || !Inputs::parseNumber(fields[1], &(vehicle_class.max_speed))
+            || !Inputs::parseNumber(fields[2], &(vehicle_class.prob_slow_down))
+            || !Inputs::parseNumber(fields[3], &(vehicle_class.prob_change))
+            || vehicle_class.fraction <= 0.0 || vehicle_class.max_speed < 1 || vehicle_class.max_speed > this->max_speed
+            || vehicle_class.prob_slow_down < 0.0 || vehicle_class.prob_slow_down > 1.0
+            || vehicle_class.prob_change < 0.0 || vehicle_class.prob_change > 1.0) {
+            std::cout << "error: invalid parameters of the vehicle class in \"" << line << "\"!" << std::endl;
+            return 1;
+        }
+        total += vehicle_class.fraction;
+        this->vehicle_classes.push_back(vehicle_class);
+    }
+
+    // The class of a Vehicle is stored in one byte
+    if (this->vehicle_classes.empty() || this->vehicle_classes.size() > 256) {
+        std::cout << "error: the file \"" << path << "\" needs between 1 and 256 vehicle classes!" << std::endl;
+        return 1;
+    }
+    for (VehicleClass& vehicle_class : this->vehicle_classes) {
+        vehicle_class.fraction /= total;
+    }
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Reads the tabulated CDF of interarrival times from the file at cdf_path into the inputs
+ * @return 0 if successful, nonzero otherwise
+ */
+int Inputs::loadCDF() {
+    CDF cdf;
+    if (cdf.read_cdf(this->cdf_path) != 0) {
+        return 1;
+    }
+    return cdf.getTable(&(this->cdf_x), &(this->cdf_values));
+}
+
+/**
+ * Broadcasts the inputs, with the Vehicle classes and the tabulated CDF, from one process to the other processes of a
+ * communicator. The inputs are packed into arrays of integers, doubles and characters in the order of the tables of
+ * the inputs, so a broadcast takes a fixed number of messages. Has to be called by all the processes of the
+ * communicator.
+ * @param comm communicator of the processes that need the inputs
+ * @param root rank of the process that has the inputs
+ * @return 0 if successful, nonzero otherwise
+ */
+int Inputs::broadcast(MPI_Comm comm, int root) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // Pack the inputs on the root
+    std::vector<int> ints;
+    std::vector<double> doubles;
+    std::string chars;
+    if (rank == root) {
+        for (IntKey int_key : INT_KEYS) {
+            ints.push_back(this->*(int_key.field));
+        }
+        for (DoubleKey double_key : DOUBLE_KEYS) {
+            doubles.push_back(this->*(double_key.field));
+        }
+        for (StringKey string_key : STRING_KEYS) {
+            ints.push_back((this->*(string_key.field)).size());
+            chars += this->*(string_key.field);
+        }
+        ints.push_back((int) this->seed);
+        ints.push_back(this->replica);
+        ints.push_back(this->vehicle_classes.size());
+        for (VehicleClass vehicle_class : this->vehicle_classes) {
+            ints.push_back(vehicle_class.max_speed);
+            doubles.push_back(vehicle_class.fraction);
+            doubles.push_back(vehicle_class.prob_slow_down);
+            doubles.push_back(vehicle_class.prob_change);
+        }
+        ints.push_back(this->cdf_x.size());
+    }
+
+    // Send the packed inputs and the CDF
+    int sizes[3] = {(int) ints.size(), (int) doubles.size(), (int) chars.size()};
+    MPI_Bcast(sizes, 3, MPI_INT, root, comm);
+    ints.resize(sizes[0]);
+    doubles.resize(sizes[1]);
+    chars.resize(sizes[2]);
+    MPI_Bcast(ints.data(), sizes[0], MPI_INT, root, comm);
+    MPI_Bcast(doubles.data(), sizes[1], MPI_DOUBLE, root, comm);
+    MPI_Bcast(chars.data(), sizes[2], MPI_CHAR, root, comm);
+    int num_points = ints.back();
+    this->cdf_x.resize(num_points);
+    this->cdf_values.resize(num_points);
+    MPI_Bcast(this->cdf_x.data(), num_points, MPI_FLOAT, root, comm);
+    MPI_Bcast(this->cdf_values.data(), num_points, MPI_FLOAT, root, comm);
+    if (rank == root) {
+        return 0;
+    }
+
+    // Unpack the inputs on the other processes, in the order they were packed
+    int i = 0;
+    int d = 0;
+    int c = 0;
+    for (IntKey int_key : INT_KEYS) {
+        this->*(int_key.field) = ints[i++];
+    }
+    for (DoubleKey double_key : DOUBLE_KEYS) {
+        this->*(double_key.field) = doubles[d++];
+    }
+    for (StringKey string_key : STRING_KEYS) {
+        int length = ints[i++];
+        this->*(string_key.field) = chars.substr(c, length);
+        c += length;
+    }
+    this->seed = (unsigned int) ints[i++];
+    this->replica = ints[i++];
+    this->vehicle_classes.resize(ints[i++]);
+    for (VehicleClass& vehicle_class : this->vehicle_classes) {
+        vehicle_class.max_speed = ints[i++];
+        vehicle_class.fraction = doubles[d++];
+        vehicle_class.prob_slow_down = doubles[d++];
+        vehicle_class.prob_change = doubles[d++];
+    }
+
     // Return with zero errors
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * Gets the path of an output file of the simulation. The replicas of an ensemble write their own files, with the
+ * number of the replica before the extension.
+ * @param path path of the output file of a single simulation
+ * @return path of the output file of this simulation
+ */
+std::string Inputs::getPath(std::string path) {
+    if (this->replica < 0) {
+        return path;
+    }
+    size_t dot = path.rfind('.');
+    std::string tag = "-" + std::to_string(this->replica);
+    return (dot == std::string::npos) ? path + tag : path.substr(0, dot) + tag + path.substr(dot);
+}
@@ -6,10 +6,25 @@
 #define CA_TRAFFIC_SIMULATION_INPUTS_H
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+/**
+ * Structure for the parameters of a class of Vehicles, with the fraction of the spawned Vehicles that are in the class
+ */
+struct VehicleClass {
+    double fraction;
+    int max_speed;
+    double prob_slow_down;
+    double prob_change;
+};
 
 /**
  * Class for the input options of a simulation that acts as a structure to organize the inputs in one place.
- * Has methods to load all the inputs from a file from an input text file.
+ * Has methods to load all the inputs from an input text file on one process, with overrides from the command line,
+ * and to broadcast them to the other processes along with the tabulated CDF of interarrival times, so that the files
+ * are only opened once however many processes there are.
  */
 class Inputs {
 public:
@@ -25,7 +40,44 @@ public:
     int max_time;
     double step_size;
     int warmup_time;
-    int loadFromFile();
+    int synchronous;
+    int balance_interval;
+    int cdf_sampler;
+    int quantiles;
+    int exchange_interval;
+    int periodic;
+    int checkpoint_interval;
+    int restart;
+    int output_interval;
+    int output_block;
+    int detector_interval;
+    int detector_spacing;
+    int device;
+    std::string classes_path;
+    std::vector<VehicleClass> vehicle_classes;
+    std::string network_path;
+    std::string cdf_path;
+    std::vector<float> cdf_x;
+    std::vector<float> cdf_values;
+    unsigned int seed;
+    int replica;
+
+    /**
+     * Number of inputs at the start of the positional input file that have no default
+     */
+    static constexpr int NUM_REQUIRED = 11;
+
+    Inputs();
+    int load(std::string path, std::vector<std::string> overrides, MPI_Comm comm);
+    int loadFromFile(std::string path, std::vector<std::string>* keys);
+    int set(std::string key, std::string value);
+    static bool parseNumber(std::string text, int* value_ptr);
+    static bool parseNumber(std::string text, double* value_ptr);
+    int validate();
+    int loadVehicleClasses(std::string path);
+    int loadCDF();
+    int broadcast(MPI_Comm comm, int root);
+    std::string getPath(std::string path);
 };
 
 
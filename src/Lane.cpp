@@ -10,24 +10,32 @@
 #include "Lane.h"
 #include "Vehicle.h"
 #include "Inputs.h"
+#include "HaloExchange.h"
+#include "GapKernel.h"
 
 /**
  * Constructor for the Lane class
  * @param inputs instance of the Inputs class with simulation inputs
  * @param lane_num the number of lane in the road, starting with zero as the first lane
+ * @param road_length_per_process number of sites in the Lane
  */
 Lane::Lane(Inputs inputs, int lane_num, int road_length_per_process) {
 #ifdef DEBUG
     std::cout << "creating lane " << lane_num << "...";
 #endif
-    // Allocate memory for the vehicle pointers list
-    this->sites.reserve(road_length_per_process);
-    this->sites.resize(road_length_per_process);
+    // Set the number of sites, with ghost sites on both sides that mirror the neighboring segments. The sites are
+    // stored by the Road, which sets them with setSites.
+    this->size = road_length_per_process;
+    this->ghost_width = HaloExchange::ghostWidth(inputs);
+    this->exit_site = this->size;
+    this->occupancy = nullptr;
+    this->bits = nullptr;
+    this->stride = 1;
 
     // Set the lane number for the lane
     this->lane_num = lane_num;
 #ifdef DEBUG
-    std::cout << "done, lane " << lane_num << " created with length " << this->sites.size() << std::endl;
+    std::cout << "done, lane " << lane_num << " created with length " << this->size << std::endl;
 #endif
 
     this->steps_to_spawn = 0;
@@ -38,7 +46,7 @@ Lane::Lane(Inputs inputs, int lane_num, int road_length_per_process) {
  * @return number of sites in the Lane
  */
 int Lane::getSize() {
-    return this->sites.size();
+    return this->size;
 }
 
 /**
@@ -50,23 +58,84 @@ int Lane::getLaneNumber() {
 }
 
 /**
- * Checks if the Lane has a Vehicle in a specific site
- * @param site the site in which to check for a Vehicle
+ * Getter method for the number of ghost sites on each side of the Lane
+ * @return number of ghost sites on each side of the Lane
+ */
+int Lane::getGhostWidth() {
+    return this->ghost_width;
+}
+
+/**
+ * Getter method for the first site at which Vehicles leave the sites updated by this process, which is the end of the
+ * Lane unless the Vehicles in the ghost sites are updated as well
+ * @return first site past the updated sites
+ */
+int Lane::getExitSite() {
+    return this->exit_site;
+}
+
+/**
+ * Setter method for the first site at which Vehicles leave the sites updated by this process
+ * @param site first site past the updated sites, at most getSize() + getGhostWidth() - 1
+ * @return 0 if successful, nonzero otherwise
+ */
+int Lane::setExitSite(int site) {
+    this->exit_site = site;
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Setter method for the storage of the sites of the Lane, which is interleaved with the other Lanes of the Road. The
+ * storage must hold getSize() + 2 * getGhostWidth() sites and be empty.
+ * @param occupancy pointer to the occupancy of the first ghost site of the Lane
+ * @param bits pointer to the first word of the bitset of the Lane
+ * @param stride number of Lanes that the storage is interleaved with, including this one
+ * @return 0 if successful, nonzero otherwise
+ */
+int Lane::setSites(unsigned char* occupancy, uint64_t* bits, int stride) {
+    this->occupancy = occupancy;
+    this->bits = bits;
+    this->stride = stride;
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Updates the bit of a site in the bitset to match the occupancy of the site
+ * @param site the site, including ghost sites
+ */
+void Lane::updateBit(int site) {
+    int bit = site + this->ghost_width;
+    uint64_t mask = UINT64_C(1) << (bit & 63);
+    if (this->occupancy[bit * this->stride]) {
+        this->bits[(bit >> 6) * this->stride] |= mask;
+    } else {
+        this->bits[(bit >> 6) * this->stride] &= ~mask;
+    }
+}
+
+/**
+ * Checks if the Lane has a Vehicle in a specific site. Sites before the start and past the end of the Lane are ghost
+ * sites that mirror the neighboring segments.
+ * @param site the site in which to check for a Vehicle, from -getGhostWidth() to getSize() + getGhostWidth() - 1
  * @return whether or not the Lane has a Vehicle in the site
  */
 bool Lane::hasVehicleInSite(int site) {
-    return !(this->sites[site].empty());
+    return this->occupancy[(site + this->ghost_width) * this->stride] != 0;
 }
 
 /**
  * Adds a Vehicle to a site in the Lane
  * @param site which site to add the Vehicle to
- * @param vehicle_ptr pointer to the Vehicle to add to the site
  * @return 0 if successful, nonzero otherwise
  */
-int Lane::addVehicle(int site, Vehicle* vehicle_ptr) {
-    // Place the Vehicle in the site
-    this->sites[site].push_back(vehicle_ptr);
+int Lane::addVehicle(int site) {
+    // Occupy the site
+    this->occupancy[(site + this->ghost_width) * this->stride]++;
+    this->updateBit(site);
 
     // Return with zero errors
     return 0;
@@ -78,23 +147,125 @@ int Lane::addVehicle(int site, Vehicle* vehicle_ptr) {
  * @return 0 if successful, nonzero otherwise
  */
 int Lane::removeVehicle(int site) {
-    // Remove the Vehicle from the site
-    this->sites[site].pop_front();
+    // Free the site
+    this->occupancy[(site + this->ghost_width) * this->stride]--;
+    this->updateBit(site);
 
     // Return with zero errors
     return 0;
 }
 
 /**
- * Attempts to spawn a Vehicle that has entered the Lane at the first site. Uses a CDF to sample to determine whether
- * or not a Vehicle was spawned.
- * @param inputs instance of the Inputs class with the simulation inputs
+ * Moves a Vehicle from one site in the Lane to another
+ * @param from_site which site to move the Vehicle from
+ * @param to_site which site to move the Vehicle to
+ * @return 0 if successful, nonzero otherwise
+ */
+int Lane::moveVehicle(int from_site, int to_site) {
+    // Update the occupancy of the sites
+    this->occupancy[(from_site + this->ghost_width) * this->stride]--;
+    this->occupancy[(to_site + this->ghost_width) * this->stride]++;
+    this->updateBit(from_site);
+    this->updateBit(to_site);
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Locates the first occupied site at or after a site, looking no further than a given number of sites ahead. Ghost
+ * sites past the end of the Lane are included.
+ * @param site the first site to check
+ * @param reach the number of sites after the first site to check
+ * @return the first occupied site, or site + reach + 1 if there is none
+ */
+int Lane::nextOccupied(int site, int reach) {
+    int first_bit = site + this->ghost_width;
+    return GapKernel::firstSet(this->bits, this->stride, first_bit, first_bit + reach) - this->ghost_width;
+}
+
+/**
+ * Locates the last occupied site at or before a site, looking no further than a given number of sites behind. Ghost
+ * sites before the start of the Lane are included.
+ * @param site the first site to check
+ * @param reach the number of sites before the first site to check
+ * @return the last occupied site, or site - reach - 1 if there is none
+ */
+int Lane::prevOccupied(int site, int reach) {
+    int last_bit = site + this->ghost_width;
+    return GapKernel::lastSet(this->bits, this->stride, last_bit - reach, last_bit) - this->ghost_width;
+}
+
+/**
+ * Marks a ghost site of the Lane as occupied or empty
+ * @param site the ghost site, either before the start or past the end of the Lane
+ * @param occupied whether or not the neighboring segment has a Vehicle in the site
+ * @return 0 if successful, nonzero otherwise
+ */
+int Lane::setGhostSite(int site, bool occupied) {
+    this->occupancy[(site + this->ghost_width) * this->stride] = occupied ? 1 : 0;
+    this->updateBit(site);
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Packs the occupancy of consecutive sites of the Lane into words of one bit per site, a word at a time from the
+ * bitset of the Lane. The bits past the last site in the last word are zero.
+ * @param first_site the first site to pack
+ * @param num_sites number of sites to pack
+ * @param words pointer to the words to pack the sites into, with room for (num_sites + 63) / 64 words
+ * @return 0 if successful, nonzero otherwise
+ */
+int Lane::packSites(int first_site, int num_sites, uint64_t* words) {
+    int num_words = (num_sites + 63) / 64;
+    int last_word = (this->size + 2 * this->ghost_width - 1) >> 6;
+    for (int j = 0; j < num_words; j++) {
+        int bit = first_site + this->ghost_width + 64 * j;
+        int w = bit >> 6;
+        int shift = bit & 63;
+        uint64_t word = this->bits[w * this->stride] >> shift;
+        if (shift != 0 && w < last_word) {
+            word |= this->bits[(w + 1) * this->stride] << (64 - shift);
+        }
+        words[j] = word;
+    }
+    if (num_sites % 64 != 0) {
+        words[num_words - 1] &= (UINT64_C(1) << (num_sites % 64)) - 1;
+    }
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Resizes the Lane to a new number of sites and moves the exit site to the end of the Lane. The storage of the sites
+ * has to be set again with setSites. The spawning state of the Lane is kept.
+ * @param road_length_per_process new number of sites in the Lane
+ * @return 0 if successful, nonzero otherwise
+ */
+int Lane::resize(int road_length_per_process) {
+    this->size = road_length_per_process;
+    this->exit_site = this->size;
+
+    // Return with zero errors
+    return 0;
+}
+
+/**
+ * Attempts to spawn a Vehicle that has entered the Lane at the first site, if the time to the next spawn has passed.
+ * The class of the Vehicle is picked from the classes of the VehicleStore. The time to the spawn after that is sampled
+ * for all the Lanes of the Road at once and set with setStepsToSpawn.
  * @param vehicles pointer to list of Vehicles to add the spawned Vehicles to
+ * @param pool_ptr pointer to the VehiclePool to acquire the spawned Vehicles from
  * @param next_id_ptr pointer to the id number of the next spawned Vehicle
- * @param interarrival_time_cdf CDF of the Vehicle interarrival times
- * @return
+ * @param id_stride step between the id numbers of the Vehicles spawned one after the other
+ * @param random_ptr pointer to the Random number generator, with draws keyed on the Lane number
+ * @return whether or not a Vehicle was spawned, so that the next spawn has to be scheduled
  */
-int Lane::attemptSpawn(Inputs inputs, std::vector<Vehicle*>* vehicles, int* next_id_ptr, CDF* interarrival_time_cdf) {
+bool Lane::attemptSpawn(std::vector<Vehicle*>* vehicles, VehiclePool* pool_ptr, int* next_id_ptr, int id_stride,
+                        Random* random_ptr) {
     if (this->steps_to_spawn == 0) {
         if (!this->hasVehicleInSite(0)) {
             // Spawn Vehicle
@@ -102,39 +273,63 @@ int Lane::attemptSpawn(Inputs inputs, std::vector<Vehicle*>* vehicles, int* next
             std::cout << "creating vehicle " << (*next_id_ptr) << " in lane " << this->lane_num << " at site " << 0
                       << std::endl;
 #endif
-            this->sites[0].push_front(new Vehicle(this, *next_id_ptr, 0, inputs));
-            (*next_id_ptr)++;
-            vehicles->push_back(this->sites[0].front());
+            // Pick the class of the Vehicle from the mix of classes, a single class needs no draw
+            VehicleStore* store_ptr = pool_ptr->getVehicleStore();
+            int vehicle_class = 0;
+            if (store_ptr->classes.size() > 1) {
+                vehicle_class = store_ptr->pickClass(random_ptr->uniform(Random::VEHICLE_CLASS, this->lane_num));
+            }
+            vehicles->push_back(pool_ptr->acquire(this->lane_num, *next_id_ptr, 0, vehicle_class));
+            this->addVehicle(0);
+            (*next_id_ptr) += id_stride;
 
             // Randomly choose the Vehicles initial speed to be zero bases in slow down probability
-            if (((double) std::rand()) / ((double) RAND_MAX) < inputs.prob_slow_down) {
+            double prob_slow_down = store_ptr->classes[vehicle_class].prob_slow_down;
+            if (random_ptr->uniform(Random::SPAWN_SPEED, this->lane_num) < prob_slow_down) {
                 vehicles->back()->setSpeed(0);
             }
-
-            // "Schedule" next Vehicle spawn
-            this->steps_to_spawn = (int) (interarrival_time_cdf->query() / inputs.step_size);
+            return true;
         }
     } else {
         this->steps_to_spawn--;
     }
+    return false;
+}
+
+/**
+ * Schedules the next Vehicle spawn in the Lane
+ * @param steps_to_spawn number of steps until the next spawn
+ * @return 0 if successful, nonzero otherwise
+ */
+int Lane::setStepsToSpawn(int steps_to_spawn) {
+    this->steps_to_spawn = steps_to_spawn;
 
     // Return with no error
     return 0;
 }
 
+/**
+ * Getter for the number of steps until the next Vehicle spawn in the Lane
+ * @return number of steps until the next spawn
+ */
+int Lane::getStepsToSpawn() {
+    return this->steps_to_spawn;
+}
+
 /**
  * Debug function to print the Lane to visualize the sites
  */
 #ifdef DEBUG
 void Lane::printLane() {
     std::ostringstream lane_string_stream;
-    for (int i = 0; i < (int) this->sites.size(); i++) {
-        if (this->sites[i].empty()) {
-            lane_string_stream << "[   ]";
+    for (int i = 0; i < this->size; i++) {
+        if (!this->hasVehicleInSite(i)) {
+            lane_string_stream << "[ ]";
         } else {
-            lane_string_stream << "[" << std::setw(3) << this->sites[i].front()->getId() << "]";
+            lane_string_stream << "[" << std::setw(1) << (int) this->occupancy[(i + this->ghost_width) * this->stride]
+                               << "]";
         }
     }
     std::cout << lane_string_stream.str() << std::endl;
 }
-#endif
\ No newline at end of file
+#endif
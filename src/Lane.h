@@ -6,35 +6,85 @@
 #define CA_TRAFFIC_SIMULATION_LANE_H
 
 #include <vector>
-#include <deque>
+#include <cstdint>
 
 #include "Inputs.h"
-#include "CDF.h"
+#include "VehiclePool.h"
+#include "Random.h"
+#include "GapKernel.h"
 
 // Forward Declarations
 class Vehicle;
 
 /**
- * Class for a lane in the road of the simulation. Each lane contains the "sites" for the vehicles and allows access
- * to all the information about the vehicles on the road through its methods.
+ * Class for a lane in the road of the simulation. Each lane has the occupancy of its "sites" as one byte per site,
+ * with ghost sites on both sides that mirror the neighboring segments, and a bitset of the same sites for locating the
+ * nearest Vehicles. The sites of all the Lanes are stored interleaved in buffers of the Road, the bytes site by site
+ * and the bitsets word by word, so that a Lane accesses them with a stride of the number of Lanes. The state of the
+ * Vehicles themselves is kept in the VehicleStore of the Road.
  */
 class Lane {
 private:
-    std::vector<std::deque<Vehicle*>> sites;
+    unsigned char* occupancy;
+    uint64_t* bits;
+    int stride;
+    int size;
+    int ghost_width;
+    int exit_site;
     int lane_num;
     int steps_to_spawn;
+    void updateBit(int site);
 public:
     Lane(Inputs inputs, int lane_num, int road_length_per_process);
     int getSize();
     int getLaneNumber();
+    int getGhostWidth();
+    int getExitSite();
+    int setExitSite(int site);
+    int setSites(unsigned char* occupancy, uint64_t* bits, int stride);
     bool hasVehicleInSite(int site);
-    int addVehicle(int site, Vehicle* vehicle_ptr);
+    int addVehicle(int site);
     int removeVehicle(int site);
-    int attemptSpawn(Inputs inputs, std::vector<Vehicle*>* vehicles, int* next_id_ptr, CDF* interarrival_time_cdf);
+    int moveVehicle(int from_site, int to_site);
+    int nextOccupied(int site, int reach);
+    int prevOccupied(int site, int reach);
+    template <int REACH> int nextOccupiedWithin(int site);
+    template <int REACH> int prevOccupiedWithin(int site);
+    int setGhostSite(int site, bool occupied);
+    int packSites(int first_site, int num_sites, uint64_t* words);
+    int resize(int road_length_per_process);
+    bool attemptSpawn(std::vector<Vehicle*>* vehicles, VehiclePool* pool_ptr, int* next_id_ptr, int id_stride,
+                      Random* random_ptr);
+    int setStepsToSpawn(int steps_to_spawn);
+    int getStepsToSpawn();
 #ifdef DEBUG
     void printLane();
 #endif
 };
 
+/**
+ * Locates the first occupied site at or after a site, looking no further than a number of sites ahead that is fixed at
+ * compile time. Ghost sites past the end of the Lane are included.
+ * @tparam REACH the number of sites after the first site to check, less than 64
+ * @param site the first site to check
+ * @return the first occupied site, or site + REACH + 1 if there is none
+ */
+template <int REACH>
+inline int Lane::nextOccupiedWithin(int site) {
+    return GapKernel::firstSetWithin<REACH>(this->bits, this->stride, site + this->ghost_width) - this->ghost_width;
+}
+
+/**
+ * Locates the last occupied site at or before a site, looking no further than a number of sites behind that is fixed
+ * at compile time. Ghost sites before the start of the Lane are included.
+ * @tparam REACH the number of sites before the first site to check, less than 64
+ * @param site the first site to check
+ * @return the last occupied site, or site - REACH - 1 if there is none
+ */
+template <int REACH>
+inline int Lane::prevOccupiedWithin(int site) {
+    return GapKernel::lastSetWithin<REACH>(this->bits, this->stride, site + this->ghost_width) - this->ghost_width;
+}
+
 
 #endif //CA_TRAFFIC_SIMULATION_LANE_H
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <algorithm>
+
+#include "LoadBalancer.h"
+#include "Lane.h"
+
+/**
+ * Constructor for the LoadBalancer
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @param comm Cartesian communicator of the segments of the Road
+ */
+LoadBalancer::LoadBalancer(Inputs inputs, MPI_Comm comm) {
+    // Determine the neighbors of the segment, which are null processes at the ends of an open Road. A single segment of
+    // a ring is its own neighbor and has nothing to balance with.
+    this->comm = comm;
+    this->periodic = inputs.periodic;
+    MPI_Comm_rank(comm, &(this->rank));
+    MPI_Comm_size(comm, &(this->size));
+    MPI_Cart_shift(comm, 0, 1, &(this->neighbor_left), &(this->neighbor_right));
+    if (this->neighbor_left == this->rank) {
+        this->neighbor_left = MPI_PROC_NULL;
+        this->neighbor_right = MPI_PROC_NULL;
+    }
+
+    // Segments can not shrink below the width of the halos, so that Vehicles still only see the neighboring segments
+    this->min_size = HaloExchange::minSegmentSize(inputs);
+
+    this->loads.resize(this->size);
+    this->flows.resize(this->size);
+    HaloExchange::createVehicleType(&(this->vehicle_type));
+    this->communication_time = 0.0;
+    this->shift = 0;
+}
+
+/**
+ * Destructor for the LoadBalancer
+ */
+LoadBalancer::~LoadBalancer() {
+    MPI_Type_free(&(this->vehicle_type));
+}
+
+/**
+ * Computes the number of Vehicles to hand over across every boundary from the gathered loads, positive if they are
+ * handed over from the segment before the boundary to the one after it. The boundary after the segment of rank n is
+ * boundary n. Across every boundary, the Vehicles before it are brought to their share of the total, which balances
+ * all the segments in one rebalance. On a ring the same amount can circulate around all the boundaries without
+ * changing the loads, so the median is taken off to hand over as few Vehicles as possible.
+ */
+void LoadBalancer::computeFlows() {
+    long long total = 0;
+    for (int n = 0; n < this->size; n++) {
+        total += this->loads[n];
+    }
+    long long before = 0;
+    for (int n = 0; n < this->size; n++) {
+        before += this->loads[n];
+        this->flows[n] = before - total * (n + 1) / this->size;
+    }
+    if (this->periodic) {
+        std::vector<long long> sorted = this->flows;
+        std::sort(sorted.begin(), sorted.end());
+        long long median = sorted[(this->size - 1) / 2];
+        for (int n = 0; n < this->size; n++) {
+            this->flows[n] -= median;
+        }
+    }
+}
+
+/**
+ * Computes the number of sites at one end of the segment to hand over to the neighbor on that side, so that the given
+ * number of Vehicles is handed over. Each end of the segment can hand over at most half of the sites above the minimum
+ * size, so that the segment keeps the minimum size when it hands over sites at both ends. The rest of the Vehicles is
+ * handed over in the next rebalances.
+ * @param positions pointer to the sorted positions of the Vehicles in the segment
+ * @param load number of Vehicles in the segment
+ * @param transfer number of Vehicles to hand over
+ * @param segment_size number of sites in the segment
+ * @param from_end whether the sites are handed over from the end or from the start of the segment
+ * @return number of sites to hand over
+ */
+int LoadBalancer::sitesToHandOver(std::vector<int>* positions, int load, long long transfer, int segment_size,
+                                  bool from_end) {
+    int count = (int) std::min(transfer, (long long) load);
+    if (count <= 0) {
+        return 0;
+    }
+
+    // Hand over the sites up to the last Vehicle that is handed over
+    int sites;
+    if (from_end) {
+        sites = segment_size - (*positions)[load - count];
+    } else {
+        sites = (*positions)[count - 1] + 1;
+    }
+    return std::max(0, std::min(sites, (segment_size - this->min_size) / 2));
+}
+
+/**
+ * Moves the boundaries of the segment towards the neighbors with fewer Vehicles, and hands over the sites and Vehicles
+ * between the neighbors. The Lanes of the Road are resized to the new segment, so their ghost sites have to be
+ * exchanged again afterwards. No exchange can be in flight when the segments are rebalanced.
+ * @param road_ptr pointer to the Road of the segment
+ * @param vehicles pointer to the list of Vehicles in the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int LoadBalancer::rebalance(Road* road_ptr, std::vector<Vehicle*>* vehicles) {
+    std::vector<Lane*> lanes = road_ptr->getLanes();
+    int segment_size = lanes[0]->getSize();
+
+    // Measure the work of every segment as its number of Vehicles
+    int load = vehicles->size();
+    double start_time = MPI_Wtime();
+    MPI_Allgather(&load, 1, MPI_INT, this->loads.data(), 1, MPI_INT, this->comm);
+    this->communication_time += MPI_Wtime() - start_time;
+
+    // Decide how many sites to hand over at each end, only the side of a boundary with too many Vehicles hands over
+    // sites
+    this->computeFlows();
+    std::vector<int> positions;
+    positions.reserve(load);
+    for (int n = 0; n < load; n++) {
+        positions.push_back((*vehicles)[n]->getPrevPosition());
+    }
+    std::sort(positions.begin(), positions.end());
+    int out_left = 0;
+    int out_right = 0;
+    if (this->neighbor_left != MPI_PROC_NULL) {
+        out_left = this->sitesToHandOver(&positions, load, -this->flows[this->neighbor_left], segment_size, false);
+    }
+    if (this->neighbor_right != MPI_PROC_NULL) {
+        out_right = this->sitesToHandOver(&positions, load, this->flows[this->rank], segment_size, true);
+    }
+
+    // Pack the Vehicles in the handed over sites, with the positions relative to the start of the handed over sites,
+    // and keep the rest in their order
+    std::vector<Vehicle*> kept;
+    kept.reserve(load);
+    for (int n = 0; n < load; n++) {
+        Vehicle* vehicle_ptr = (*vehicles)[n];
+        int position = vehicle_ptr->getPrevPosition();
+        VehicleData vdata = {
+            vehicle_ptr->getVehicleLane(),
+            vehicle_ptr->getId(),
+            position,
+            vehicle_ptr->getSpeed(),
+            vehicle_ptr->getTimeOnRoad(),
+            vehicle_ptr->getVehicleClass()
+        };
+        if (position < out_left) {
+            this->send_left.push_back(vdata);
+            road_ptr->getVehiclePool()->release(vehicle_ptr);
+        } else if (position >= segment_size - out_right) {
+            vdata.position -= segment_size - out_right;
+            this->send_right.push_back(vdata);
+            road_ptr->getVehiclePool()->release(vehicle_ptr);
+        } else {
+            kept.push_back(vehicle_ptr);
+        }
+    }
+
+    // Tell the neighbors how many sites and Vehicles they receive, nothing is received from a null process
+    int send_left_counts[2] = {out_left, (int) this->send_left.size()};
+    int send_right_counts[2] = {out_right, (int) this->send_right.size()};
+    int recv_left_counts[2] = {0, 0};
+    int recv_right_counts[2] = {0, 0};
+    start_time = MPI_Wtime();
+    MPI_Sendrecv(send_right_counts, 2, MPI_INT, this->neighbor_right, 4, recv_left_counts, 2, MPI_INT,
+                 this->neighbor_left, 4, this->comm, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(send_left_counts, 2, MPI_INT, this->neighbor_left, 5, recv_right_counts, 2, MPI_INT,
+                 this->neighbor_right, 5, this->comm, MPI_STATUS_IGNORE);
+
+    // Hand over the Vehicles
+    this->recv_left.resize(recv_left_counts[1]);
+    this->recv_right.resize(recv_right_counts[1]);
+    MPI_Sendrecv(this->send_right.data(), this->send_right.size(), this->vehicle_type, this->neighbor_right, 6,
+                 this->recv_left.data(), this->recv_left.size(), this->vehicle_type, this->neighbor_left, 6,
+                 this->comm, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(this->send_left.data(), this->send_left.size(), this->vehicle_type, this->neighbor_left, 7,
+                 this->recv_right.data(), this->recv_right.size(), this->vehicle_type, this->neighbor_right, 7,
+                 this->comm, MPI_STATUS_IGNORE);
+    this->communication_time += MPI_Wtime() - start_time;
+
+    // Resize the segment, the sites received from the left neighbor come before the old start of the segment
+    int shift = recv_left_counts[0] - out_left;
+    this->shift = shift;
+    int new_size = segment_size - out_left - out_right + recv_left_counts[0] + recv_right_counts[0];
+    road_ptr->resize(new_size);
+
+    // Place the Vehicles in the resized Lanes, the Vehicles from the right neighbor are ahead of the kept ones and the
+    // Vehicles from the left neighbor behind them
+    vehicles->clear();
+    for (int n = 0; n < (int) this->recv_right.size(); n++) {
+        VehicleData vdata = this->recv_right[n];
+        vdata.position += segment_size + shift;
+        Vehicle* new_vehicle = road_ptr->getVehiclePool()->acquire(vdata.lane, vdata.id, vdata.position,
+                                                                   vdata.vehicle_class);
+        new_vehicle->setSpeed(vdata.speed);
+        new_vehicle->setTimeOnRoad(vdata.time_on_road);
+        vehicles->push_back(new_vehicle);
+    }
+    for (int n = 0; n < (int) kept.size(); n++) {
+        kept[n]->setPosition(kept[n]->getPrevPosition() + shift);
+        vehicles->push_back(kept[n]);
+    }
+    for (int n = 0; n < (int) this->recv_left.size(); n++) {
+        VehicleData vdata = this->recv_left[n];
+        Vehicle* new_vehicle = road_ptr->getVehiclePool()->acquire(vdata.lane, vdata.id, vdata.position,
+                                                                   vdata.vehicle_class);
+        new_vehicle->setSpeed(vdata.speed);
+        new_vehicle->setTimeOnRoad(vdata.time_on_road);
+        vehicles->push_back(new_vehicle);
+    }
+    for (int n = 0; n < (int) vehicles->size(); n++) {
+        lanes[(*vehicles)[n]->getVehicleLane()]->addVehicle((*vehicles)[n]->getPrevPosition());
+    }
+#ifdef DEBUG
+    std::cout << "rank " << this->rank << " rebalanced to " << new_size << " sites with " << vehicles->size()
+              << " vehicles" << std::endl;
+#endif
+
+    // The buffers can be reused for the next rebalance
+    this->send_left.clear();
+    this->send_right.clear();
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the total time spent in the communication of the rebalancing, including the time spent waiting for the
+ * other processes
+ * @return communication time in seconds
+ */
+double LoadBalancer::getCommunicationTime() {
+    return this->communication_time;
+}
+
+/**
+ * Getter for the number of sites that the start of the segment moved back in the last rebalance, negative if the start
+ * moved forward
+ * @return the shift of the start of the segment
+ */
+int LoadBalancer::getShift() {
+    return this->shift;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_LOADBALANCER_H
+#define CA_TRAFFIC_SIMULATION_LOADBALANCER_H
+
+#include <vector>
+#include <mpi.h>
+
+#include "Inputs.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "HaloExchange.h"
+
+/**
+ * Class for balancing the Vehicles between the segments of the Road. The Vehicles enter at the start of the Road and
+ * traffic builds up unevenly, so the boundaries between the segments are moved towards the processes with fewer
+ * Vehicles. The number of Vehicles to hand over across every boundary is computed from the prefix sums of the loads
+ * of all the segments, so that each segment ends up with its share of the total. Every boundary is moved by its two
+ * neighboring processes only, with the side that has too many Vehicles handing over the sites and Vehicles, as packed
+ * Vehicles in the same format as the HaloExchange.
+ */
+class LoadBalancer {
+private:
+    MPI_Comm comm;
+    int rank;
+    int size;
+    int periodic;
+    int neighbor_left;
+    int neighbor_right;
+    int min_size;
+    MPI_Datatype vehicle_type;
+    std::vector<int> loads;
+    std::vector<long long> flows;
+    std::vector<VehicleData> send_left;
+    std::vector<VehicleData> send_right;
+    std::vector<VehicleData> recv_left;
+    std::vector<VehicleData> recv_right;
+    double communication_time;
+    int shift;
+    void computeFlows();
+    int sitesToHandOver(std::vector<int>* positions, int load, long long transfer, int segment_size, bool from_end);
+public:
+    LoadBalancer(Inputs inputs, MPI_Comm comm);
+    ~LoadBalancer();
+    int rebalance(Road* road_ptr, std::vector<Vehicle*>* vehicles);
+    double getCommunicationTime();
+    int getShift();
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_LOADBALANCER_H
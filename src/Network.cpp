@@ -0,0 +1,619 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <deque>
+#include <cstddef>
+#include <cmath>
+
+#include "Network.h"
+
+/**
+ * Constructor for the Network
+ * @param inputs instance of the Inputs class with the parameters that all the links share
+ * @param comm communicator of the processes that run the Network
+ */
+Network::Network(Inputs inputs, MPI_Comm comm) {
+    this->inputs = inputs;
+    this->comm = comm;
+    MPI_Comm_rank(comm, &(this->rank));
+    MPI_Comm_size(comm, &(this->size));
+    this->graph_comm = MPI_COMM_NULL;
+    this->time = 0;
+    this->travel_time = new Statistic(inputs.quantiles != 0);
+    this->num_cut = 0;
+    this->imbalance = 1.0;
+    this->num_remaining = 0;
+    this->num_transferred = 0;
+    this->elapsed_time = 0.0;
+
+    // Create the MPI datatype for a Vehicle that turns into the link of another process
+    MPI_Datatype vehicle_type;
+    HaloExchange::createVehicleType(&vehicle_type);
+    int block_lengths[2] = {1, 1};
+    MPI_Aint displacements[2] = {offsetof(Transfer, link), offsetof(Transfer, vehicle)};
+    MPI_Datatype types[2] = {MPI_INT, vehicle_type};
+    MPI_Datatype struct_type;
+    MPI_Type_create_struct(2, block_lengths, displacements, types, &struct_type);
+    MPI_Type_create_resized(struct_type, 0, sizeof(Transfer), &(this->transfer_type));
+    MPI_Type_commit(&(this->transfer_type));
+    MPI_Type_free(&struct_type);
+    MPI_Type_free(&vehicle_type);
+}
+
+/**
+ * Destructor for the Network
+ */
+Network::~Network() {
+    // Delete the Roads of the links, which delete the Vehicles in their VehiclePools
+    for (Road* road_ptr : this->roads) {
+        delete road_ptr;
+    }
+    delete this->travel_time;
+    MPI_Type_free(&(this->transfer_type));
+    if (this->graph_comm != MPI_COMM_NULL) {
+        MPI_Comm_free(&(this->graph_comm));
+    }
+}
+
+/**
+ * Prints an error in the Network on the first process
+ * @param message the error message
+ * @return 1, the status of the failed Network
+ */
+int Network::reportError(std::string message) {
+    if (this->rank == 0) {
+        std::cout << "error: " << message << "!" << std::endl;
+    }
+    return 1;
+}
+
+/**
+ * Loads the links of the Network from a text file on the first process and broadcasts them to the other processes,
+ * then partitions the links across the processes and creates the Roads of the links of this process. Has to be called
+ * by all the processes.
+ * @param path path of the network file
+ * @return 0 if successful, nonzero otherwise, the same on every process
+ */
+int Network::loadFromFile(std::string path) {
+    int status = 0;
+    if (this->rank == 0) {
+        status = this->readLinks(path);
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, this->comm);
+    if (status != 0) {
+        return status;
+    }
+    this->broadcastLinks();
+
+    // Every process partitions the links the same way, so the owners of the links need no communication
+    this->partition();
+    this->createGraph();
+
+    // Create a Road for every link of this process, every link has its own random numbers and numbers its spawned
+    // Vehicles from the link index with a stride of the number of links, so the numbers never collide
+    int num_links = this->links.size();
+    this->local_index.assign(num_links, -1);
+    for (int l = 0; l < num_links; l++) {
+        if (this->links[l].owner != this->rank) {
+            continue;
+        }
+        Inputs link_inputs = this->inputs;
+        link_inputs.num_lanes = this->links[l].num_lanes;
+        link_inputs.length = this->links[l].length;
+        link_inputs.seed = this->inputs.seed + l;
+        link_inputs.periodic = 0;
+        link_inputs.exchange_interval = 1;
+        link_inputs.detector_interval = 0;
+        this->local_index[l] = this->local_links.size();
+        this->local_links.push_back(l);
+        this->roads.push_back(new Road(link_inputs, link_inputs.length));
+        this->roads.back()->setIdStride(num_links);
+        this->next_ids.push_back(l);
+    }
+    this->vehicles.resize(this->local_links.size());
+    this->waiting.resize(this->local_links.size());
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Reads the links of the Network from a text file with one entry per line. A link is given by "link <lanes> <length>",
+ * followed by "source" if Vehicles spawn at its start, and a turn by "turn <from> <to> <fraction>" with the indices of
+ * the links in the order of the file and the fraction of the Vehicles at the end of the first link that turn into the
+ * second. The fractions of the turns of a link are normalized. Empty lines and lines that start with # are skipped.
+ * @param path path of the network file
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::readLinks(std::string path) {
+    std::ifstream network_file(path);
+    if (!network_file) {
+        return this->reportError("failure to open \"" + path + "\" file");
+    }
+
+    std::vector<std::vector<double>> fractions;
+    std::string line;
+    while (std::getline(network_file, line)) {
+        std::stringstream stream(line);
+        std::string kind;
+        if (!(stream >> kind) || kind[0] == '#') {
+            continue;
+        }
+        if (kind == "link") {
+            Link link = {0, 0, 0, {}, {}, 0};
+            std::string source;
+            if (!(stream >> link.num_lanes >> link.length)) {
+                return this->reportError("missing number of lanes or length in \"" + line + "\"");
+            }
+            if (stream >> source) {
+                if (source != "source") {
+                    return this->reportError("unknown option \"" + source + "\" in \"" + line + "\"");
+                }
+                link.source = 1;
+            }
+
+            // A Vehicle never crosses a whole link in one step, so it lands on the link it turned into
+            if (link.num_lanes < 1 || link.length < std::max(this->inputs.max_speed, 1)) {
+                return this->reportError("the link in \"" + line + "\" needs a lane and at least max_speed sites");
+            }
+            this->links.push_back(link);
+            fractions.emplace_back();
+        } else if (kind == "turn") {
+            int from, to;
+            double fraction;
+            if (!(stream >> from >> to >> fraction)) {
+                return this->reportError("missing links or fraction in \"" + line + "\"");
+            }
+            if (from < 0 || from >= (int) this->links.size() || to < 0 || to >= (int) this->links.size()) {
+                return this->reportError("the turn in \"" + line + "\" is not between two links above it");
+            }
+            if (fraction <= 0.0) {
+                return this->reportError("the fraction in \"" + line + "\" is not positive");
+            }
+            this->links[from].turns.push_back(to);
+            fractions[from].push_back(fraction);
+        } else {
+            return this->reportError("unknown entry \"" + kind + "\" in \"" + line + "\"");
+        }
+    }
+    if (this->links.empty()) {
+        return this->reportError("the network in \"" + path + "\" has no links");
+    }
+
+    // Accumulate the normalized fractions of the turns of every link
+    bool has_source = false;
+    for (int l = 0; l < (int) this->links.size(); l++) {
+        has_source = has_source || this->links[l].source;
+        double total = 0.0;
+        for (double fraction : fractions[l]) {
+            total += fraction;
+        }
+        double cumulative = 0.0;
+        for (double fraction : fractions[l]) {
+            cumulative += fraction / total;
+            this->links[l].turn_cdf.push_back(cumulative);
+        }
+        if (!fractions[l].empty()) {
+            this->links[l].turn_cdf.back() = 1.0;
+        }
+    }
+    if (!has_source) {
+        return this->reportError("the network in \"" + path + "\" has no source link");
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Broadcasts the links of the Network from the first process to the other processes, as one list of the integers and
+ * one list of the fractions of all the links
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::broadcastLinks() {
+    std::vector<int> ints;
+    std::vector<double> doubles;
+    if (this->rank == 0) {
+        ints.push_back(this->links.size());
+        for (const Link& link : this->links) {
+            ints.push_back(link.num_lanes);
+            ints.push_back(link.length);
+            ints.push_back(link.source);
+            ints.push_back(link.turns.size());
+            ints.insert(ints.end(), link.turns.begin(), link.turns.end());
+            doubles.insert(doubles.end(), link.turn_cdf.begin(), link.turn_cdf.end());
+        }
+    }
+    int sizes[2] = {(int) ints.size(), (int) doubles.size()};
+    MPI_Bcast(sizes, 2, MPI_INT, 0, this->comm);
+    ints.resize(sizes[0]);
+    doubles.resize(sizes[1]);
+    MPI_Bcast(ints.data(), sizes[0], MPI_INT, 0, this->comm);
+    MPI_Bcast(doubles.data(), sizes[1], MPI_DOUBLE, 0, this->comm);
+
+    if (this->rank != 0) {
+        int i = 0;
+        int d = 0;
+        this->links.resize(ints[i++]);
+        for (Link& link : this->links) {
+            link.num_lanes = ints[i++];
+            link.length = ints[i++];
+            link.source = ints[i++];
+            int num_turns = ints[i++];
+            link.turns.assign(ints.begin() + i, ints.begin() + i + num_turns);
+            link.turn_cdf.assign(doubles.begin() + d, doubles.begin() + d + num_turns);
+            i += num_turns;
+            d += num_turns;
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Partitions the links across the processes, weighted by their number of sites. The links are visited breadth first
+ * from the source links through the turns and the order is cut into parts of about the same weight, so the parts are
+ * connected groups of links. Then every link at the edge of a part moves to the part that most of its neighbors are in,
+ * as long as that removes turns between the parts and keeps the parts within 10% of the average weight.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::partition() {
+    int num_links = this->links.size();
+    int num_parts = std::min(this->size, num_links);
+
+    // The turns join the links both ways for the partition
+    std::vector<std::vector<int>> neighbors(num_links);
+    for (int l = 0; l < num_links; l++) {
+        for (int to : this->links[l].turns) {
+            if (to != l) {
+                neighbors[l].push_back(to);
+                neighbors[to].push_back(l);
+            }
+        }
+    }
+    std::vector<double> weights(num_links);
+    double total_weight = 0.0;
+    for (int l = 0; l < num_links; l++) {
+        weights[l] = (double) this->links[l].num_lanes * this->links[l].length;
+        total_weight += weights[l];
+    }
+    double target = total_weight / num_parts;
+
+    // Visit the links breadth first, from the source links first and then from any links that were not reached
+    std::vector<int> order;
+    std::vector<bool> visited(num_links, false);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int start = 0; start < num_links; start++) {
+            if (visited[start] || (pass == 0 && !this->links[start].source)) {
+                continue;
+            }
+            std::deque<int> frontier = {start};
+            visited[start] = true;
+            while (!frontier.empty()) {
+                int l = frontier.front();
+                frontier.pop_front();
+                order.push_back(l);
+                for (int next : neighbors[l]) {
+                    if (!visited[next]) {
+                        visited[next] = true;
+                        frontier.push_back(next);
+                    }
+                }
+            }
+        }
+    }
+
+    // Cut the order into parts at the multiples of the target weight, a link goes to the part with its middle
+    std::vector<double> part_weights(num_parts, 0.0);
+    double cumulative = 0.0;
+    for (int l : order) {
+        int part = std::min(num_parts - 1, (int) ((cumulative + 0.5 * weights[l]) / target));
+        this->links[l].owner = part;
+        part_weights[part] += weights[l];
+        cumulative += weights[l];
+    }
+
+    // Move the links at the edges of the parts to the part of most of their neighbors, in the order of the links
+    std::vector<int> counts(num_parts);
+    for (int l = 0; l < num_links; l++) {
+        std::fill(counts.begin(), counts.end(), 0);
+        for (int next : neighbors[l]) {
+            counts[this->links[next].owner]++;
+        }
+        int own = this->links[l].owner;
+        int best = own;
+        for (int part = 0; part < num_parts; part++) {
+            if (counts[part] > counts[best] && part_weights[part] + weights[l] <= 1.1 * target) {
+                best = part;
+            }
+        }
+        if (best != own && part_weights[own] > weights[l]) {
+            this->links[l].owner = best;
+            part_weights[own] -= weights[l];
+            part_weights[best] += weights[l];
+        }
+    }
+
+    // Measure the turns between the parts and the heaviest part against the average
+    this->num_cut = 0;
+    for (int l = 0; l < num_links; l++) {
+        for (int to : this->links[l].turns) {
+            this->num_cut += (this->links[to].owner != this->links[l].owner);
+        }
+    }
+    this->imbalance = *std::max_element(part_weights.begin(), part_weights.end()) / (total_weight / this->size);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Creates the distributed graph communicator of the processes that own the links at the ends of the turns between the
+ * parts, so that every process only exchanges Vehicles with the processes that own the neighboring links
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::createGraph() {
+    for (int l = 0; l < (int) this->links.size(); l++) {
+        int from = this->links[l].owner;
+        for (int to_link : this->links[l].turns) {
+            int to = this->links[to_link].owner;
+            if (from == to) {
+                continue;
+            }
+            if (from == this->rank) {
+                this->destinations.push_back(to);
+            }
+            if (to == this->rank) {
+                this->sources.push_back(from);
+            }
+        }
+    }
+    for (std::vector<int>* ranks : {&(this->sources), &(this->destinations)}) {
+        std::sort(ranks->begin(), ranks->end());
+        ranks->erase(std::unique(ranks->begin(), ranks->end()), ranks->end());
+    }
+    MPI_Dist_graph_create_adjacent(this->comm, this->sources.size(), this->sources.data(), MPI_UNWEIGHTED,
+                                   this->destinations.size(), this->destinations.data(), MPI_UNWEIGHTED,
+                                   MPI_INFO_NULL, 0, &(this->graph_comm));
+    this->outgoing.resize(this->destinations.size());
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Handles a Vehicle that reached the end of a link, which turns into one of the links that the link leads to, or
+ * leaves the Network and has its travel time recorded if the link leads nowhere
+ * @param k index of the link among the links of this process
+ * @param vehicle_ptr pointer to the Vehicle that reached the end of the link
+ * @param time_on_road number of steps that the Vehicle has been in the Network
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::leaveLink(int k, Vehicle* vehicle_ptr, int time_on_road) {
+    const Link& link = this->links[this->local_links[k]];
+    if (link.turns.empty()) {
+        if (this->time > this->inputs.warmup_time) {
+            this->travel_time->addValue(vehicle_ptr->getTravelTime(this->inputs));
+        }
+        return 0;
+    }
+
+    // Pick the turn with a draw keyed on the Vehicle, so the turn does not depend on the partition
+    double u = this->roads[k]->getRandom()->uniform(Random::TURN, vehicle_ptr->getId());
+    int turn = std::upper_bound(link.turn_cdf.begin(), link.turn_cdf.end() - 1, u) - link.turn_cdf.begin();
+    int to = link.turns[turn];
+    VehicleData vdata = {
+        vehicle_ptr->getVehicleLane(),
+        vehicle_ptr->getId(),
+        vehicle_ptr->getNewPosition(),
+        vehicle_ptr->getSpeed(),
+        time_on_road,
+        vehicle_ptr->getVehicleClass()
+    };
+    int owner = this->links[to].owner;
+    if (owner == this->rank) {
+        this->waiting[this->local_index[to]].push_back(vdata);
+    } else {
+        int d = std::lower_bound(this->destinations.begin(), this->destinations.end(), owner) -
+                this->destinations.begin();
+        this->outgoing[d].push_back({to, vdata});
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Performs the lane switch and lane move steps of the Vehicles of a link, in the order of the list of the link, and
+ * removes the Vehicles that reached the end of the link
+ * @param k index of the link among the links of this process
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::stepLink(int k) {
+    Road* road_ptr = this->roads[k];
+    road_ptr->getRandom()->setStep(this->time);
+    std::vector<Vehicle*>& link_vehicles = this->vehicles[k];
+    for (int n = 0; n < (int) link_vehicles.size(); n++) {
+        Vehicle* vehicle_ptr = link_vehicles[n];
+        int lane = vehicle_ptr->getVehicleLane();
+        vehicle_ptr->updateGaps(road_ptr);
+        vehicle_ptr->performLaneSwitch(road_ptr);
+        if (vehicle_ptr->getVehicleLane() != lane) {
+            vehicle_ptr->updateGaps(road_ptr);
+        }
+        int time_on_road = vehicle_ptr->performLaneMove(road_ptr);
+        if (time_on_road != 0) {
+            this->leaveLink(k, vehicle_ptr, time_on_road);
+            road_ptr->getVehiclePool()->release(vehicle_ptr);
+            link_vehicles[n] = nullptr;
+        }
+    }
+    link_vehicles.erase(std::remove(link_vehicles.begin(), link_vehicles.end(), nullptr), link_vehicles.end());
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Exchanges the Vehicles that turned into the links of other processes with the neighboring processes in the graph,
+ * the numbers of Vehicles first and the Vehicles after, and adds the received Vehicles to the links they turned into
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::exchange() {
+    int num_destinations = this->destinations.size();
+    int num_sources = this->sources.size();
+    std::vector<int> send_counts(num_destinations), send_displacements(num_destinations);
+    std::vector<int> recv_counts(num_sources), recv_displacements(num_sources);
+    std::vector<Transfer> send_buffer;
+    for (int d = 0; d < num_destinations; d++) {
+        send_counts[d] = this->outgoing[d].size();
+        send_displacements[d] = send_buffer.size();
+        send_buffer.insert(send_buffer.end(), this->outgoing[d].begin(), this->outgoing[d].end());
+        this->outgoing[d].clear();
+    }
+    MPI_Neighbor_alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, this->graph_comm);
+    int num_received = 0;
+    for (int s = 0; s < num_sources; s++) {
+        recv_displacements[s] = num_received;
+        num_received += recv_counts[s];
+    }
+    std::vector<Transfer> recv_buffer(num_received);
+    MPI_Neighbor_alltoallv(send_buffer.data(), send_counts.data(), send_displacements.data(), this->transfer_type,
+                           recv_buffer.data(), recv_counts.data(), recv_displacements.data(), this->transfer_type,
+                           this->graph_comm);
+    for (const Transfer& transfer : recv_buffer) {
+        this->waiting[this->local_index[transfer.link]].push_back(transfer.vehicle);
+    }
+    this->num_transferred += send_buffer.size();
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Places the Vehicles that turned into a link at the start of the link, in the order of their ids. A Vehicle lands at
+ * the site it reached past the end of the previous link, or the nearest empty site behind it, in its Lane or the last
+ * Lane of the link if it has fewer Lanes. A Vehicle that finds no empty site waits at the junction and enters in a
+ * later step, still counting the steps on the Network.
+ * @param k index of the link among the links of this process
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::enterLink(int k) {
+    std::vector<VehicleData>& arrivals = this->waiting[k];
+    if (arrivals.empty()) {
+        return 0;
+    }
+    std::sort(arrivals.begin(), arrivals.end(), [](const VehicleData& a, const VehicleData& b) {
+        return a.id < b.id;
+    });
+    Road* road_ptr = this->roads[k];
+    int num_lanes = this->links[this->local_links[k]].num_lanes;
+    int num_waiting = 0;
+    for (VehicleData vdata : arrivals) {
+        vdata.lane = std::min(vdata.lane, num_lanes - 1);
+        Lane* lane_ptr = road_ptr->getLane(vdata.lane);
+        int site = vdata.position;
+        while (site >= 0 && lane_ptr->hasVehicleInSite(site)) {
+            site--;
+        }
+        if (site < 0) {
+            vdata.position = 0;
+            vdata.speed = 0;
+            vdata.time_on_road++;
+            arrivals[num_waiting++] = vdata;
+            continue;
+        }
+        Vehicle* new_vehicle = road_ptr->getVehiclePool()->acquire(vdata.lane, vdata.id, site, vdata.vehicle_class);
+        new_vehicle->setSpeed(vdata.speed);
+        new_vehicle->setTimeOnRoad(vdata.time_on_road);
+        lane_ptr->addVehicle(site);
+        this->vehicles[k].push_back(new_vehicle);
+    }
+    arrivals.resize(num_waiting);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Runs the Network for the number of steps of the inputs. Every step updates the links of this process one after the
+ * other, exchanges the Vehicles that turned into the links of other processes, places the arrived Vehicles and spawns
+ * Vehicles at the start of the source links. Has to be called by all the processes.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::run() {
+    double start_time = MPI_Wtime();
+    int num_local = this->local_links.size();
+    for (this->time = 0; this->time < this->inputs.max_time;) {
+        for (int k = 0; k < num_local; k++) {
+            this->stepLink(k);
+        }
+        this->exchange();
+        for (int k = 0; k < num_local; k++) {
+            this->enterLink(k);
+        }
+
+        // End of iteration steps
+        // Increment time
+        this->time++;
+
+        // Spawn new Vehicles at the start of the source links
+        for (int k = 0; k < num_local; k++) {
+            if (this->links[this->local_links[k]].source) {
+                this->roads[k]->attemptSpawn(this->inputs, &(this->vehicles[k]), &(this->next_ids[k]));
+            }
+        }
+    }
+    this->elapsed_time = MPI_Wtime() - start_time;
+
+    // Combine the statistics of all the processes on the first process
+    long long counts[2] = {0, this->num_transferred};
+    for (int k = 0; k < num_local; k++) {
+        counts[0] += this->vehicles[k].size() + this->waiting[k].size();
+    }
+    long long totals[2];
+    MPI_Reduce(counts, totals, 2, MPI_LONG_LONG, MPI_SUM, 0, this->comm);
+    this->num_remaining = totals[0];
+    this->num_transferred = totals[1];
+    this->travel_time->reduce(0, this->comm);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Prints the partition of the links and the statistics of the Network, on the first process
+ * @return 0 if successful, nonzero otherwise
+ */
+int Network::printResults() {
+    double time_elapsed = this->elapsed_time;
+    std::cout << "--- Network Performance ---" << std::endl;
+    std::cout << "total computation time: " << time_elapsed << " [s]" << std::endl;
+    std::cout << "average time per iteration: " << time_elapsed / inputs.max_time << " [s]" << std::endl;
+    std::cout << "average iterating frequency: " << inputs.max_time / time_elapsed << " [iter/s]" << std::endl;
+    std::cout << "partition: links=" << this->links.size() << ", processes=" << this->size
+              << ", cut turns=" << this->num_cut << ", imbalance=" << this->imbalance << std::endl;
+    std::cout << "vehicles sent between processes: " << this->num_transferred << std::endl;
+
+    std::cout << "--- Combined Statistics Across All Processes ---" << std::endl;
+    std::cout << "time on network: avg=" << this->travel_time->getAverage()
+              << ", std=" << pow(this->travel_time->getVariance(), 0.5)
+              << ", N=" << this->travel_time->getNumSamples()
+              << std::endl;
+    if (this->travel_time->hasQuantiles()) {
+        std::cout << "time on network: p50=" << this->travel_time->getQuantile(0.5)
+                  << ", p90=" << this->travel_time->getQuantile(0.9)
+                  << ", p99=" << this->travel_time->getQuantile(0.99)
+                  << std::endl;
+    }
+    std::cout << "vehicles on network at the end: " << this->num_remaining << std::endl;
+
+    // Return with no errors
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_NETWORK_H
+#define CA_TRAFFIC_SIMULATION_NETWORK_H
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+
+#include "Inputs.h"
+#include "Road.h"
+#include "Vehicle.h"
+#include "Statistic.h"
+#include "HaloExchange.h"
+
+/**
+ * Structure for a link of a road network, a Road from one junction to the next. The Vehicles that reach the end of
+ * the link turn into one of the links that it leads to, picked with the cumulative fractions of the turns, and leave
+ * the network if it leads nowhere.
+ */
+struct Link {
+    int num_lanes;
+    int length;
+    int source;
+    std::vector<int> turns;
+    std::vector<double> turn_cdf;
+    int owner;
+};
+
+/**
+ * Structure for a Vehicle that turns into a link owned by another process, with its position past the start of the
+ * link
+ */
+struct Transfer {
+    int link;
+    VehicleData vehicle;
+};
+
+/**
+ * Class for simulating a network of links joined at junctions. Every link is a Road that is updated whole by one
+ * process, and the links are partitioned across the processes by growing the parts breadth first through the junctions
+ * and moving the links at the edges of the parts to the part of most of their neighbors, so that few turns cross
+ * between processes. The Vehicles that turn into the links of other processes are exchanged every step with the
+ * processes that own the neighboring links only, through a distributed graph communicator. The Vehicles that arrive
+ * at a link enter it in the order of their ids, so the results do not depend on the partition.
+ */
+class Network {
+private:
+    Inputs inputs;
+    MPI_Comm comm;
+    MPI_Comm graph_comm;
+    MPI_Datatype transfer_type;
+    int rank;
+    int size;
+    int time;
+    std::vector<Link> links;
+    std::vector<int> local_links;
+    std::vector<int> local_index;
+    std::vector<Road*> roads;
+    std::vector<std::vector<Vehicle*>> vehicles;
+    std::vector<int> next_ids;
+    std::vector<std::vector<VehicleData>> waiting;
+    std::vector<int> sources;
+    std::vector<int> destinations;
+    std::vector<std::vector<Transfer>> outgoing;
+    Statistic* travel_time;
+    int num_cut;
+    double imbalance;
+    long long num_remaining;
+    long long num_transferred;
+    double elapsed_time;
+    int reportError(std::string message);
+    int readLinks(std::string path);
+    int broadcastLinks();
+    int partition();
+    int createGraph();
+    int leaveLink(int k, Vehicle* vehicle_ptr, int time_on_road);
+    int stepLink(int k);
+    int exchange();
+    int enterLink(int k);
+public:
+    Network(Inputs inputs, MPI_Comm comm);
+    ~Network();
+    int loadFromFile(std::string path);
+    int run();
+    int printResults();
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_NETWORK_H
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstddef>
+
+#include "Profiler.h"
+
+/**
+ * Constructor for the Profiler
+ */
+Profiler::Profiler() {
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        this->totals[phase] = 0.0;
+        this->calls[phase] = 0;
+        this->items[phase] = 0;
+    }
+    this->origin = MPI_Wtime();
+
+    // Bound the memory of the timeline, the totals keep counting after the timeline is full
+    this->max_events = 1 << 20;
+}
+
+/**
+ * Getter for the name of a phase, as it appears in the trace and the summary
+ * @param phase the phase
+ * @return name of the phase
+ */
+const char* Profiler::getPhaseName(int phase) {
+    static const char* names[NUM_PHASES] = {
+        "step",
+        "update interior",
+        "update boundary",
+        "gaps",
+        "lane switch",
+        "speed",
+        "move",
+        "halo post",
+        "halo wait",
+        "place incoming",
+        "ghosts",
+        "remove",
+        "spawn",
+        "rebalance",
+        "checkpoint",
+        "output",
+        "detectors",
+        "device"
+    };
+    return names[phase];
+}
+
+/**
+ * Starts the timeline of all the processes at the same time
+ * @param comm communicator of the processes
+ * @return 0 if successful, nonzero otherwise
+ */
+int Profiler::start(MPI_Comm comm) {
+    MPI_Barrier(comm);
+    this->origin = MPI_Wtime();
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Records a timed phase
+ * @param phase the phase
+ * @param start_time time at which the phase started
+ * @param end_time time at which the phase ended
+ * @return 0 if successful, nonzero otherwise
+ */
+int Profiler::record(int phase, double start_time, double end_time) {
+    this->totals[phase] += end_time - start_time;
+    this->calls[phase]++;
+    if ((int) this->events.size() < this->max_events) {
+        this->events.push_back({phase, start_time - this->origin, end_time - start_time});
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Counts the items, Vehicles or messages, that a phase processed
+ * @param phase the phase
+ * @param num_items number of items
+ * @return 0 if successful, nonzero otherwise
+ */
+int Profiler::count(int phase, long long num_items) {
+    this->items[phase] += num_items;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Gathers the phases of all the processes on rank 0, which writes the timelines as a Chrome trace and prints the
+ * average, minimum and maximum time of every phase across the processes
+ * @param comm communicator of the processes
+ * @param trace_path path of the trace file
+ * @return 0 if successful, nonzero otherwise
+ */
+int Profiler::report(MPI_Comm comm, std::string trace_path) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Describe the TraceEvents to MPI
+    MPI_Datatype event_type;
+    int block_lengths[3] = {1, 1, 1};
+    MPI_Aint displacements[3] = {offsetof(TraceEvent, phase), offsetof(TraceEvent, start),
+                                 offsetof(TraceEvent, duration)};
+    MPI_Datatype types[3] = {MPI_INT, MPI_DOUBLE, MPI_DOUBLE};
+    MPI_Datatype structure;
+    MPI_Type_create_struct(3, block_lengths, displacements, types, &structure);
+    MPI_Type_create_resized(structure, 0, sizeof(TraceEvent), &event_type);
+    MPI_Type_free(&structure);
+    MPI_Type_commit(&event_type);
+
+    // Gather the timelines and the totals of the phases
+    int num_events = this->events.size();
+    std::vector<int> counts(size);
+    MPI_Gather(&num_events, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+    std::vector<int> offsets(size, 0);
+    for (int r = 1; r < size; r++) {
+        offsets[r] = offsets[r - 1] + counts[r - 1];
+    }
+    std::vector<TraceEvent> all_events((rank == 0) ? offsets[size - 1] + counts[size - 1] : 0);
+    MPI_Gatherv(this->events.data(), num_events, event_type, all_events.data(), counts.data(), offsets.data(),
+                event_type, 0, comm);
+    MPI_Type_free(&event_type);
+
+    std::vector<double> all_totals((rank == 0) ? size * NUM_PHASES : 0);
+    std::vector<long long> all_calls((rank == 0) ? size * NUM_PHASES : 0);
+    std::vector<long long> all_items((rank == 0) ? size * NUM_PHASES : 0);
+    MPI_Gather(this->totals, NUM_PHASES, MPI_DOUBLE, all_totals.data(), NUM_PHASES, MPI_DOUBLE, 0, comm);
+    MPI_Gather(this->calls, NUM_PHASES, MPI_LONG_LONG, all_calls.data(), NUM_PHASES, MPI_LONG_LONG, 0, comm);
+    MPI_Gather(this->items, NUM_PHASES, MPI_LONG_LONG, all_items.data(), NUM_PHASES, MPI_LONG_LONG, 0, comm);
+    if (rank != 0) {
+        return 0;
+    }
+
+    // Write the timelines as complete events in microseconds, with a process in the trace for every rank. The times
+    // are written with a fixed number of decimals, so they keep nanoseconds however long the run is.
+    std::ofstream trace_file;
+    trace_file.open(trace_path, std::ofstream::out);
+    if (!trace_file) {
+        std::cout << "error: failure to open \"" << trace_path << "\" file!" << std::endl;
+        return 1;
+    }
+    trace_file << std::fixed << std::setprecision(3);
+    trace_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (int r = 0; r < size; r++) {
+        trace_file << ((r == 0) ? "" : ",") << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << r
+                   << ",\"args\":{\"name\":\"rank " << r << "\"}}";
+        for (int k = offsets[r]; k < offsets[r] + counts[r]; k++) {
+            TraceEvent event = all_events[k];
+            trace_file << ",\n{\"name\":\"" << Profiler::getPhaseName(event.phase) << "\",\"ph\":\"X\",\"ts\":"
+                       << event.start * 1e6 << ",\"dur\":" << event.duration * 1e6 << ",\"pid\":" << r
+                       << ",\"tid\":0}";
+        }
+    }
+    trace_file << "\n]}" << std::endl;
+    trace_file.close();
+
+    // Print the phases that were timed, the spread between the processes shows the load imbalance and the waiting
+    std::cout << "--- Phase Timings Across All Processes ---" << std::endl;
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        long long phase_calls = 0;
+        long long phase_items = 0;
+        double total = 0.0;
+        int min_rank = 0;
+        int max_rank = 0;
+        for (int r = 0; r < size; r++) {
+            double time = all_totals[r * NUM_PHASES + phase];
+            phase_calls += all_calls[r * NUM_PHASES + phase];
+            phase_items += all_items[r * NUM_PHASES + phase];
+            total += time;
+            if (time < all_totals[min_rank * NUM_PHASES + phase]) {
+                min_rank = r;
+            }
+            if (time > all_totals[max_rank * NUM_PHASES + phase]) {
+                max_rank = r;
+            }
+        }
+        if (phase_calls == 0) {
+            continue;
+        }
+        std::cout << Profiler::getPhaseName(phase) << ": avg=" << total / size
+                  << ", min=" << all_totals[min_rank * NUM_PHASES + phase] << " (rank " << min_rank << ")"
+                  << ", max=" << all_totals[max_rank * NUM_PHASES + phase] << " (rank " << max_rank << ")"
+                  << " [s], calls=" << phase_calls << ", items=" << phase_items << std::endl;
+    }
+    if (num_events >= this->max_events) {
+        std::cout << "warning: the timeline of rank 0 was truncated at " << this->max_events << " events"
+                  << std::endl;
+    }
+    std::cout << "trace written to " << trace_path << std::endl;
+
+    // Return with no errors
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_PROFILER_H
+#define CA_TRAFFIC_SIMULATION_PROFILER_H
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+
+/**
+ * Structure for a timed phase on the timeline of a process, with the times in seconds since the start of the Profiler
+ */
+struct TraceEvent {
+    int phase;
+    double start;
+    double duration;
+};
+
+/**
+ * Class for the instrumentation of the phases of the simulation. Accumulates the time, the number of calls and the
+ * number of items (Vehicles or messages) of every phase, and records a timeline of the phases up to a maximum number
+ * of events. At the end, the timelines of all the processes are written as a Chrome trace that can be opened in
+ * Perfetto, and a summary of the phases across the processes is printed. The phases are timed by the main thread of a
+ * process, around the loops that the threads share. The instrumentation is compiled out unless CATS_TRACE is defined.
+ */
+class Profiler {
+public:
+    /**
+     * Phases of a step of the simulation
+     */
+    enum Phase {
+        STEP = 0,
+        UPDATE_INTERIOR = 1,
+        UPDATE_BOUNDARY = 2,
+        GAPS = 3,
+        LANE_SWITCH = 4,
+        SPEED = 5,
+        MOVE = 6,
+        HALO_POST = 7,
+        HALO_WAIT = 8,
+        PLACE_INCOMING = 9,
+        GHOSTS = 10,
+        REMOVE = 11,
+        SPAWN = 12,
+        REBALANCE = 13,
+        CHECKPOINT = 14,
+        OUTPUT = 15,
+        DETECTORS = 16,
+        DEVICE = 17,
+        NUM_PHASES = 18
+    };
+
+    Profiler();
+    static const char* getPhaseName(int phase);
+    int start(MPI_Comm comm);
+    int record(int phase, double start_time, double end_time);
+    int count(int phase, long long num_items);
+    int report(MPI_Comm comm, std::string trace_path);
+private:
+    double origin;
+    double totals[NUM_PHASES];
+    long long calls[NUM_PHASES];
+    long long items[NUM_PHASES];
+    std::vector<TraceEvent> events;
+    int max_events;
+};
+
+/**
+ * Class for timing a phase from its construction to the end of its scope
+ */
+class ScopedTimer {
+private:
+    Profiler* profiler_ptr;
+    int phase;
+    double start_time;
+public:
+    /**
+     * Constructor for the ScopedTimer, starts timing the phase
+     * @param profiler_ptr pointer to the Profiler to record the phase in
+     * @param phase the phase
+     */
+    ScopedTimer(Profiler* profiler_ptr, int phase) {
+        this->profiler_ptr = profiler_ptr;
+        this->phase = phase;
+        this->start_time = MPI_Wtime();
+    }
+
+    /**
+     * Destructor for the ScopedTimer, records the phase
+     */
+    ~ScopedTimer() {
+        this->profiler_ptr->record(this->phase, this->start_time, MPI_Wtime());
+    }
+};
+
+// Macros for the instrumentation, which expand to nothing unless CATS_TRACE is defined
+#ifdef CATS_TRACE
+#define CATS_CONCAT_NAME(a, b) a##b
+#define CATS_SCOPED_NAME(a, b) CATS_CONCAT_NAME(a, b)
+#define CATS_PROFILE(profiler_ptr, phase) ScopedTimer CATS_SCOPED_NAME(scoped_timer_, __LINE__)(profiler_ptr, phase)
+#define CATS_COUNT(profiler_ptr, phase, num_items) (profiler_ptr)->count(phase, num_items)
+#else
+#define CATS_PROFILE(profiler_ptr, phase)
+#define CATS_COUNT(profiler_ptr, phase, num_items)
+#endif
+
+
+#endif //CA_TRAFFIC_SIMULATION_PROFILER_H
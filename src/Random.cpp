@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include "Random.h"
+
+/**
+ * Constructor for the Random number generator
+ * @param seed seed of the generator, which must be the same on every process
+ */
+Random::Random(uint64_t seed) {
+    this->key[0] = (uint32_t) seed;
+    this->key[1] = (uint32_t) (seed >> 32);
+    this->step = 0;
+}
+
+/**
+ * Sets the step of the simulation that the next random numbers are drawn for
+ * @param step the step of the simulation
+ * @return 0 if successful, nonzero otherwise
+ */
+int Random::setStep(int step) {
+    this->step = (uint32_t) step;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the step of the simulation that the random numbers are drawn for
+ * @return the step of the simulation
+ */
+int Random::getStep() {
+    return (int) this->step;
+}
+
+/**
+ * Sets the seed of the generator, which restarts the streams of random numbers
+ * @param seed seed of the generator, which must be the same on every process
+ * @return 0 if successful, nonzero otherwise
+ */
+int Random::setSeed(uint64_t seed) {
+    this->key[0] = (uint32_t) seed;
+    this->key[1] = (uint32_t) (seed >> 32);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the seed of the generator
+ * @return the seed of the generator
+ */
+uint64_t Random::getSeed() {
+    return ((uint64_t) this->key[1] << 32) | this->key[0];
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_RANDOM_H
+#define CA_TRAFFIC_SIMULATION_RANDOM_H
+
+#include <cstdint>
+
+/**
+ * Class for the counter-based random number generator of the simulation, using the Philox4x32-10 generator. A random
+ * number is a pure function of the seed, the step, the kind of draw and the subject of the draw (a Vehicle id or a Lane
+ * number), so the numbers do not depend on how the Road is partitioned or on the order of the draws, and the generator
+ * can be used from several threads at once without locks.
+ */
+class Random {
+private:
+    uint32_t key[2];
+    uint32_t step;
+public:
+    /**
+     * Kinds of draws in the simulation, each kind uses an independent stream of random numbers
+     */
+    enum Draw {
+        LANE_SWITCH = 0,
+        SLOW_DOWN = 1,
+        SPAWN_SPEED = 2,
+        SPAWN_INTERVAL = 3,
+        VEHICLE_CLASS = 4,
+        TURN = 5
+    };
+
+    Random(uint64_t seed);
+    int setStep(int step);
+    int getStep();
+    int setSeed(uint64_t seed);
+    uint64_t getSeed();
+
+    /**
+     * Applies the ten rounds of the Philox4x32 bijection to a counter
+     * @param counter the counter, replaced by the random output
+     * @param key the key of the generator
+     */
+    static inline void philox(uint32_t counter[4], const uint32_t key[2]) {
+        uint32_t k0 = key[0];
+        uint32_t k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            uint64_t product0 = (uint64_t) UINT32_C(0xD2511F53) * counter[0];
+            uint64_t product1 = (uint64_t) UINT32_C(0xCD9E8D57) * counter[2];
+            uint32_t c0 = (uint32_t) (product1 >> 32) ^ counter[1] ^ k0;
+            uint32_t c2 = (uint32_t) (product0 >> 32) ^ counter[3] ^ k1;
+            counter[1] = (uint32_t) product1;
+            counter[3] = (uint32_t) product0;
+            counter[0] = c0;
+            counter[2] = c2;
+            k0 += UINT32_C(0x9E3779B9);
+            k1 += UINT32_C(0xBB67AE85);
+        }
+    }
+
+    /**
+     * Draws a uniformly distributed random number for the current step
+     * @param draw the kind of draw
+     * @param subject the Vehicle id or Lane number that the draw is for
+     * @return random number in [0, 1)
+     */
+    inline double uniform(Draw draw, int subject) const {
+        uint32_t counter[4] = {(uint32_t) subject, this->step, (uint32_t) draw, 0};
+        philox(counter, this->key);
+        return ((((uint64_t) counter[0]) << 21) ^ (counter[1] >> 11)) * (1.0 / 9007199254740992.0);
+    }
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_RANDOM_H
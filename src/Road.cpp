@@ -4,6 +4,7 @@
 
 #include "Road.h"
 #include "Inputs.h"
+#include "StepKernel.h"
 
 /**
  * Constructor for the Road
@@ -17,15 +18,40 @@ Road::Road(Inputs inputs, int road_length_per_process) {
     for (int i = 0; i < inputs.num_lanes; i++) {
         this->lanes.push_back(new Lane(inputs, i, road_length_per_process));
     }
+    this->allocateSites(road_length_per_process);
 #ifdef DEBUG
     std::cout << "done creating road" << std::endl;
 #endif
 
     this->interarrival_time_cdf = new CDF();
-    int status = this->interarrival_time_cdf->read_cdf("interarrival-cdf.dat");
+    int status = this->interarrival_time_cdf->setTable(inputs.cdf_x, inputs.cdf_values);
+    if (status == 0) {
+        status = this->interarrival_time_cdf->setSampler(inputs.cdf_sampler);
+    }
     if (status != 0) {
         throw std::exception();
     }
+
+    // Create the storage for the state of the Vehicles on the Road
+    this->store_ptr = new VehicleStore(inputs);
+    this->pool_ptr = new VehiclePool(this->store_ptr);
+
+    // Create the random number generator, which is the same on every process
+    this->random_ptr = new Random(inputs.seed);
+
+    // Select the gap updates for the inputs
+    this->kernel_ptr = new StepKernel(inputs);
+
+    // The spawned Vehicles are numbered one after the other unless several Roads share the id numbers
+    this->id_stride = 1;
+
+    // The Vehicles are only counted at the detectors when the Simulation has enabled them
+    this->detectors_ptr = nullptr;
+
+    // Allocate the buffers for sampling the times to the next spawns of all the Lanes at once
+    this->spawned_lanes.reserve(inputs.num_lanes);
+    this->spawn_uniforms.reserve(inputs.num_lanes);
+    this->spawn_intervals.resize(inputs.num_lanes);
 }
 
 /**
@@ -36,6 +62,13 @@ Road::~Road() {
     for (int i = 0; i < (int) this->lanes.size(); i++) {
         delete this->lanes[i];
     }
+
+    // Delete the Vehicles, the storage for the Vehicles and the CDF
+    delete this->pool_ptr;
+    delete this->store_ptr;
+    delete this->interarrival_time_cdf;
+    delete this->random_ptr;
+    delete this->kernel_ptr;
 }
 
 /**
@@ -47,15 +80,152 @@ std::vector<Lane*> Road::getLanes() {
 }
 
 /**
- * Attempts to spawn Vehicles on each Lane of the Road
+ * Getter for a single Lane of the road, without copying the list of Lanes
+ * @param lane_num the number of the Lane
+ * @return pointer to the Lane
+ */
+Lane* Road::getLane(int lane_num) {
+    return this->lanes[lane_num];
+}
+
+/**
+ * Getter for the storage of the state of the Vehicles on the Road
+ * @return pointer to the VehicleStore
+ */
+VehicleStore* Road::getVehicleStore() {
+    return this->store_ptr;
+}
+
+/**
+ * Getter for the pool of Vehicles on the Road
+ * @return pointer to the VehiclePool
+ */
+VehiclePool* Road::getVehiclePool() {
+    return this->pool_ptr;
+}
+
+/**
+ * Getter for the random number generator of the Road
+ * @return pointer to the Random number generator
+ */
+Random* Road::getRandom() {
+    return this->random_ptr;
+}
+
+/**
+ * Getter for the StepKernel with the gap updates of the Vehicles on the Road
+ * @return pointer to the StepKernel
+ */
+StepKernel* Road::getStepKernel() {
+    return this->kernel_ptr;
+}
+
+/**
+ * Setter for the step between the id numbers of the Vehicles spawned on the Road, so that the Roads of a Network with
+ * different first id numbers never spawn Vehicles with the same id number
+ * @param id_stride step between the id numbers of the spawned Vehicles
+ * @return 0 if successful, nonzero otherwise
+ */
+int Road::setIdStride(int id_stride) {
+    this->id_stride = id_stride;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the occupancy of the sites of all the Lanes, one byte per site interleaved by Lane
+ * @return pointer to the occupancy of the sites
+ */
+std::vector<unsigned char>* Road::getOccupancy() {
+    return &(this->occupancy);
+}
+
+/**
+ * Getter for the bitsets of the sites of all the Lanes, interleaved word by word by Lane
+ * @return pointer to the bitsets of the sites
+ */
+std::vector<uint64_t>* Road::getBits() {
+    return &(this->bits);
+}
+
+/**
+ * Getter for the Detectors that count the Vehicles moving on the Road
+ * @return pointer to the Detectors, or nullptr if there are no detectors
+ */
+Detectors* Road::getDetectors() {
+    return this->detectors_ptr;
+}
+
+/**
+ * Setter for the Detectors that count the Vehicles moving on the Road, which are owned by the Simulation
+ * @param detectors_ptr pointer to the Detectors, or nullptr to stop counting the Vehicles
+ * @return 0 if successful, nonzero otherwise
+ */
+int Road::setDetectors(Detectors* detectors_ptr) {
+    this->detectors_ptr = detectors_ptr;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Allocates the empty sites of all the Lanes for a number of sites in the segment, interleaved so that the occupancy
+ * of site k of Lane i is byte k * num_lanes + i and word w of the bitset of Lane i is word w * num_lanes + i
+ * @param road_length_per_process number of sites in the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Road::allocateSites(int road_length_per_process) {
+    int num_lanes = this->lanes.size();
+    int num_sites = road_length_per_process + 2 * this->lanes[0]->getGhostWidth();
+    this->occupancy.assign((size_t) num_sites * num_lanes, 0);
+    this->bits.assign((size_t) ((num_sites + 63) / 64) * num_lanes, 0);
+    for (int i = 0; i < num_lanes; i++) {
+        this->lanes[i]->setSites(this->occupancy.data() + i, this->bits.data() + i, num_lanes);
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Resizes all the Lanes of the Road to a new number of sites, which leaves them empty
+ * @param road_length_per_process new number of sites in the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Road::resize(int road_length_per_process) {
+    for (int i = 0; i < (int) this->lanes.size(); i++) {
+        this->lanes[i]->resize(road_length_per_process);
+    }
+    this->allocateSites(road_length_per_process);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Attempts to spawn Vehicles on each Lane of the Road, and samples the times to the next spawns of all the Lanes that
+ * spawned a Vehicle at once
  * @param inputs instance of the Inputs class with the simulation Inputs
  * @param vehicles pointer to the array of Vehicles that exist
  * @param next_id_ptr pointer to the id of the next spawned Vehicle
  * @return 0 if successful, nonzero otherwise
  */
-int Road::attemptSpawn(Inputs inputs, std::vector<Vehicle*>* vehicles, int* next_id_ptr) {
+int Road::attemptSpawn(const Inputs& inputs, std::vector<Vehicle*>* vehicles, int* next_id_ptr) {
+    this->spawned_lanes.clear();
+    this->spawn_uniforms.clear();
     for (int i = 0; i < (int) this->lanes.size(); i++) {
-        this->lanes[i]->attemptSpawn(inputs, vehicles, next_id_ptr, this->interarrival_time_cdf);
+        if (this->lanes[i]->attemptSpawn(vehicles, this->pool_ptr, next_id_ptr, this->id_stride, this->random_ptr)) {
+            this->spawned_lanes.push_back(i);
+            this->spawn_uniforms.push_back(this->random_ptr->uniform(Random::SPAWN_INTERVAL, i));
+        }
+    }
+
+    // "Schedule" the next Vehicle spawns
+    int num_spawned = this->spawned_lanes.size();
+    this->interarrival_time_cdf->sample(num_spawned, this->spawn_uniforms.data(), this->spawn_intervals.data());
+    for (int k = 0; k < num_spawned; k++) {
+        this->lanes[this->spawned_lanes[k]]->setStepsToSpawn((int) (this->spawn_intervals[k] / inputs.step_size));
     }
 
     // Return with no errors
@@ -6,24 +6,58 @@
 #define CA_TRAFFIC_SIMULATION_ROAD_H
 
 #include <vector>
+#include <cstdint>
 
 #include "Lane.h"
 #include "Inputs.h"
 #include "CDF.h"
+#include "VehicleStore.h"
+#include "VehiclePool.h"
+#include "Random.h"
+
+// Forward declarations
+class StepKernel;
+class Detectors;
 
 /**
- * Class for the Road in the Simulation. The road has multiple Lanes that each contain Vehicles. Has methods to attempt
- * spawning Vehicles in the Lanes
+ * Class for the Road in the Simulation. The road has multiple Lanes that each contain Vehicles, a VehicleStore with
+ * the state of the Vehicles, a VehiclePool that recycles the Vehicles, the Random number generator for the Vehicles and
+ * the StepKernel with the gap updates of the Vehicles.
+ * The sites of the Lanes are stored interleaved, so that the sites of all the Lanes at a position are close together
+ * for the Vehicles that look at the neighboring Lanes. Has methods to attempt spawning Vehicles in the Lanes
  */
 class Road {
 private:
     std::vector<Lane*> lanes;
+    std::vector<unsigned char> occupancy;
+    std::vector<uint64_t> bits;
     CDF* interarrival_time_cdf;
+    VehicleStore* store_ptr;
+    VehiclePool* pool_ptr;
+    Random* random_ptr;
+    StepKernel* kernel_ptr;
+    int id_stride;
+    Detectors* detectors_ptr;
+    std::vector<int> spawned_lanes;
+    std::vector<double> spawn_uniforms;
+    std::vector<double> spawn_intervals;
+    int allocateSites(int road_length_per_process);
 public:
     Road(Inputs inputs, int road_length_per_process);
     ~Road();
     std::vector<Lane*> getLanes();
-    int attemptSpawn(Inputs inputs, std::vector<Vehicle*>* vehicles, int* next_id_ptr);
+    Lane* getLane(int lane_num);
+    VehicleStore* getVehicleStore();
+    VehiclePool* getVehiclePool();
+    Random* getRandom();
+    StepKernel* getStepKernel();
+    int setIdStride(int id_stride);
+    std::vector<unsigned char>* getOccupancy();
+    std::vector<uint64_t>* getBits();
+    Detectors* getDetectors();
+    int setDetectors(Detectors* detectors_ptr);
+    int resize(int road_length_per_process);
+    int attemptSpawn(const Inputs& inputs, std::vector<Vehicle*>* vehicles, int* next_id_ptr);
 
 #ifdef DEBUG
     void printRoad();
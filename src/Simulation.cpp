@@ -8,7 +8,11 @@
 #include "Road.h"
 #include "Simulation.h"
 #include "Vehicle.h"
+#include "HaloExchange.h"
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 /**
  * Constructor for the Simulation
  * @param inputs
@@ -17,6 +21,7 @@ Simulation::Simulation(Inputs inputs, int road_length_per_process) {
 
     // Create the Road object for the simulation
     this->road_ptr = new Road(inputs, road_length_per_process);
+    this->lanes = this->road_ptr->getLanes();
     
     // Initialize the first Vehicle id
     this->next_id = 0;
@@ -25,238 +30,1099 @@ Simulation::Simulation(Inputs inputs, int road_length_per_process) {
     this->inputs = inputs;
 
     // Initialize Statistic for travel time
-    this->travel_time = new Statistic();
+    this->travel_time = new Statistic(inputs.quantiles != 0);
+
+    // Initialize Statistic for the speed of the Vehicles on a ring
+    this->speed = new Statistic();
+
+    // Initialize the instrumentation of the phases of a step
+    this->profiler_ptr = new Profiler();
+
+    // The output of the state of the Road, the detectors and the device engine are created by run_simulation if they
+    // are enabled
+    this->frames_ptr = nullptr;
+    this->detectors_ptr = nullptr;
+    this->device_ptr = nullptr;
+    this->digest_ptr = nullptr;
+    this->segment_start = 0;
 }
 
 /**
  * Destructor for the Simulation
  */
 Simulation::~Simulation() {
-    // Delete the Road object in the simulation
+    // Delete the Road object in the simulation, which deletes the Vehicles in its VehiclePool, after the device engine
+    // that copies the Vehicles back to it
+    delete this->device_ptr;
     delete this->road_ptr;
+    delete this->travel_time;
+    delete this->speed;
+    delete this->profiler_ptr;
+    delete this->frames_ptr;
+    delete this->detectors_ptr;
+}
+
+/**
+ * Hands a Vehicle that left the segment over to the right neighbor or, at the end of the Road, adds it to the travel
+ * time Statistic. On a ring, the speed of a Vehicle that is handed over is added to the speed Statistic.
+ * @param vehicle_ptr pointer to the Vehicle that left the segment
+ * @param time_on_road time on road of the Vehicle
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::leaveSegment(Vehicle* vehicle_ptr, int time_on_road, HaloExchange* halo_ptr) {
+    if (halo_ptr->hasRightNeighbor()) {
+        // Hand the Vehicle over to the next segment
+        VehicleData vdata = {
+            vehicle_ptr->getVehicleLane(),
+            vehicle_ptr->getId(),
+            vehicle_ptr->getNewPosition(),
+            vehicle_ptr->getSpeed(),
+            time_on_road,
+            vehicle_ptr->getVehicleClass()
+        };
+        if (halo_ptr->pushOutgoing(vdata) != 0) {
+            std::cerr << "error: too many vehicles crossing the boundary of rank " << this->rank << std::endl;
+            MPI_Abort(this->road_comm, 1);
+        }
+
+        // The Vehicle arrives in the next step, so the detectors that it crossed in the next segment are counted here
+        if (this->detectors_ptr != nullptr) {
+            this->detectors_ptr->recordHandOver(vdata.position, vdata.speed);
+        }
+
+        // The Vehicle is in flight at the end of the step, so it is added to the digest of the step here
+        if (this->digest_ptr != nullptr) {
+            this->digest_ptr->addVehicle(vdata.id, vdata.lane, this->segment_start + this->lanes[0]->getSize() +
+                                         vdata.position, vdata.speed, vdata.time_on_road);
+        }
+
+        // The Vehicle is in flight when the speeds of this step are measured, so its speed is measured here instead
+        if (this->inputs.periodic && this->time >= this->inputs.warmup_time) {
+            this->speed->addValue(vdata.speed);
+        }
+    } else {
+        if (this->time > this->inputs.warmup_time) {
+            // Update travel time statistic if beyond warm-up period
+            this->travel_time->addValue(vehicle_ptr->getTravelTime(this->inputs));
+        }
+        if (this->digest_ptr != nullptr) {
+            this->digest_ptr->addDeparture(time_on_road);
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Performs the lane switch and lane move of a single Vehicle for the current step
+ * @param vehicle_ptr pointer to the Vehicle to update
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @return true if the Vehicle left the segment and has to be removed, false otherwise
+ */
+bool Simulation::stepVehicle(Vehicle* vehicle_ptr, HaloExchange* halo_ptr) {
+    // Perform the lane switch step for the Vehicle, the gaps only change if the Vehicle switched Lanes
+    int lane = vehicle_ptr->getVehicleLane();
+    vehicle_ptr->updateGaps(this->road_ptr);
+    vehicle_ptr->performLaneSwitch(this->road_ptr);
+    if (vehicle_ptr->getVehicleLane() != lane) {
+        vehicle_ptr->updateGaps(this->road_ptr);
+    }
 
-    // Delete all the Vehicle objects in the Simulation
-    for (int i = 0; i < (int) this->vehicles.size(); i++) {
-        delete this->vehicles[i];
+    // Perform the lane move step for the Vehicle
+    int time_on_road = vehicle_ptr->performLaneMove(this->road_ptr);
+    if (time_on_road == 0) {
+        return false;
     }
+    this->leaveSegment(vehicle_ptr, time_on_road, halo_ptr);
+    return true;
 }
 
 /**
- * Executes the simulation in parallel using the specified number of threads
- * @param num_threads number of threads to run the simulation with
+ * Places the Vehicles that arrived from the left neighbor in the Lanes. They are updated along with the boundary
+ * Vehicles.
+ * @param halo_ptr pointer to the completed HaloExchange with the neighbors of the segment
  * @return 0 if successful, nonzero otherwise
  */
-int Simulation::run_simulation(int rank, int size, int road_length_per_process) {
+int Simulation::placeIncoming(HaloExchange* halo_ptr) {
+    CATS_PROFILE(this->profiler_ptr, Profiler::PLACE_INCOMING);
+    CATS_COUNT(this->profiler_ptr, Profiler::PLACE_INCOMING, halo_ptr->getNumIncoming());
+    for (int n = 0; n < halo_ptr->getNumIncoming(); n++) {
+        VehicleData vdata = halo_ptr->getIncoming(n);
+        Vehicle* new_vehicle = this->road_ptr->getVehiclePool()->acquire(vdata.lane, vdata.id, vdata.position,
+                                                                         vdata.vehicle_class);
+        new_vehicle->setSpeed(vdata.speed);
+        new_vehicle->setTimeOnRoad(vdata.time_on_road);
+        this->road_ptr->getLane(vdata.lane)->addVehicle(vdata.position);
+        this->vehicles.push_back(new_vehicle);
+        this->boundary_vehicles.push_back(this->vehicles.size() - 1);
+    }
 
-    int neighbor_left = rank - 1;
-    int neighbor_right = rank + 1;
+    // Return with no errors
+    return 0;
+}
 
-    int vector_size;
-    int total_car_time;
+/**
+ * Releases the Vehicles that left the segment during the step and removes them from the list of Vehicles. The removed
+ * Vehicles are replaced by null pointers and the list is compacted in a single pass, which keeps the order of the
+ * remaining Vehicles.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::removeVehicles() {
+    if (this->vehicles_to_remove.empty()) {
+        return 0;
+    }
+    for (int n : this->vehicles_to_remove) {
+        this->road_ptr->getVehiclePool()->release(this->vehicles[n]);
+        this->vehicles[n] = nullptr;
+    }
+    this->vehicles.erase(std::remove(this->vehicles.begin(), this->vehicles.end(), nullptr), this->vehicles.end());
+    this->vehicles_to_remove.clear();
 
-    struct VehicleData {
-        int lane;
-        int id;
-        int position;
-        int speed;
-        int time_on_road;
-    };
+    // Return with no errors
+    return 0;
+}
 
-    std::chrono::steady_clock::time_point begin;
+/**
+ * Completes the exchange in flight and places the Vehicles that arrived from the left neighbor, so that every Vehicle
+ * is in the segment of the process that owns it. The placed Vehicles are updated as boundary Vehicles of the next step
+ * all the same.
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::completeExchange(HaloExchange* halo_ptr) {
+    halo_ptr->wait(&(this->lanes));
+    this->placeIncoming(halo_ptr);
+    this->boundary_vehicles.clear();
 
-    begin = std::chrono::steady_clock::now();
+    // Return with no errors
+    return 0;
+}
 
-    // Set the simulation time to zero
-    this->time = 0;
+/**
+ * Adds a Vehicle to the list of Vehicles of a block for the next update of the blocks. A block is made active by its
+ * first Vehicle, and only the active blocks are updated, so the update costs the number of Vehicles and not the number
+ * of sites.
+ * @param n index of the Vehicle in the list of Vehicles
+ * @param block the block of the sites of the Vehicle
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::addToBlock(int n, int block) {
+    if (this->block_vehicles[block].empty()) {
+        this->active_blocks[block % 2].push_back(block);
+    }
+    this->block_vehicles[block].push_back(n);
 
-    // Declare a vector for vehicles to be removed each step
-    std::vector<int> vehicles_to_remove;
-    std::vector<VehicleData> send_to_right;
-    std::vector<VehicleData> send_to_left;
-    std::vector<int> removed_vehicles_times;
-    VehicleData vdata;
-    
-    std::vector<Vehicle*> local_vehicles;
-    std::vector<Lane*> lanes = road_ptr->getLanes();
-    std::vector<int> local_vehicles_to_remove;
+    // Return with no errors
+    return 0;
+}
 
-    while (this->time < this->inputs.max_time) {
+/**
+ * Performs one step of the sequential update, where each Vehicle switches lanes and moves before the next Vehicle is
+ * updated. Each step first updates the Vehicles that cannot see the segment boundaries, while the exchange with the
+ * neighbors from the previous step is in flight, and then completes the exchange and updates the Vehicles near the
+ * boundaries.
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::stepSequential(HaloExchange* halo_ptr) {
+    // Sort the interior Vehicles into their blocks and set the boundary Vehicles aside
+    for (int n = 0; n < (int) this->vehicles.size(); n++) {
+        int position = this->vehicles[n]->getPrevPosition();
+        if (position < this->interior_begin || position >= this->interior_end) {
+            this->boundary_vehicles.push_back(n);
+        } else {
+            this->addToBlock(n, position / this->block_size);
+        }
+    }
 
-        if(rank == 0){
-            // Perform the lane switch step for all vehicles
-            for (int n = 0; n < (int) this->vehicles.size(); n++) {
-                this->vehicles[n]->updateGaps(this->road_ptr);
-                this->vehicles[n]->performLaneSwitch(this->road_ptr);
+    // Update the interior Vehicles while the exchange is in flight, first the even and then the odd active blocks
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::UPDATE_INTERIOR);
+        CATS_COUNT(this->profiler_ptr, Profiler::UPDATE_INTERIOR,
+                   this->vehicles.size() - this->boundary_vehicles.size());
+        for (int phase = 0; phase < 2; phase++) {
+            std::vector<int>* active = &(this->active_blocks[phase]);
+#pragma omp parallel for schedule(dynamic)
+            for (int k = 0; k < (int) active->size(); k++) {
+                int b = (*active)[k];
+                for (int n : this->block_vehicles[b]) {
+                    if (this->stepVehicle(this->vehicles[n], halo_ptr)) {
+#pragma omp critical
+                        this->vehicles_to_remove.push_back(n);
+                    }
+                }
+                this->block_vehicles[b].clear();
+            }
+            active->clear();
+        }
+    }
+
+    // Complete the exchange, which fills the ghost sites, and place the Vehicles that arrived from the left neighbor
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::HALO_WAIT);
+        halo_ptr->wait(&(this->lanes));
+    }
+    this->placeIncoming(halo_ptr);
+
+    // Update the boundary Vehicles
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::UPDATE_BOUNDARY);
+        CATS_COUNT(this->profiler_ptr, Profiler::UPDATE_BOUNDARY, this->boundary_vehicles.size());
+        for (int n : this->boundary_vehicles) {
+            if (this->stepVehicle(this->vehicles[n], halo_ptr)) {
+                this->vehicles_to_remove.push_back(n);
+            }
+        }
+    }
+    this->boundary_vehicles.clear();
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Changes the lanes of all the Vehicles that decided to change lanes from the same state. Two Vehicles in the Lanes on
+ * both sides of a site can decide to change into it, so the changes to higher Lanes are made first and have priority,
+ * and a Vehicle changing to a lower Lane stays in its Lane if the site has been taken. The result does not depend on
+ * the order of the Vehicles.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::applyLaneSwitches() {
+    CATS_PROFILE(this->profiler_ptr, Profiler::LANE_SWITCH);
+    int num_vehicles = this->vehicles.size();
+    CATS_COUNT(this->profiler_ptr, Profiler::LANE_SWITCH, num_vehicles);
+    for (int n = 0; n < num_vehicles; n++) {
+        this->vehicles[n]->applyLaneSwitch(this->road_ptr, Vehicle::HIGHER);
+    }
+    for (int n = 0; n < num_vehicles; n++) {
+        this->vehicles[n]->applyLaneSwitch(this->road_ptr, Vehicle::LOWER);
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Performs one step of the synchronous update of Rickert et al., where all the Vehicles decide on lane changes from the
+ * same state and change lanes together, and then all the Vehicles update their speeds from the same state and move
+ * together. The result does not depend on the order of the Vehicles or on the partitioning of the Road.
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::stepSynchronous(HaloExchange* halo_ptr) {
+    int num_vehicles = this->vehicles.size();
+
+    // Decide on the lane changes of the interior Vehicles while the exchange is in flight
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::GAPS);
+        CATS_COUNT(this->profiler_ptr, Profiler::GAPS, num_vehicles);
+#pragma omp parallel for schedule(static)
+        for (int n = 0; n < num_vehicles; n++) {
+            int position = this->vehicles[n]->getPrevPosition();
+            if (position >= this->interior_begin && position < this->interior_end) {
                 this->vehicles[n]->updateGaps(this->road_ptr);
+                this->vehicles[n]->decideLaneSwitch(this->road_ptr);
             }
+        }
+    }
+
+    // Complete the exchange, then decide on the lane changes of the boundary and arriving Vehicles
+    for (int n = 0; n < num_vehicles; n++) {
+        int position = this->vehicles[n]->getPrevPosition();
+        if (position < this->interior_begin || position >= this->interior_end) {
+            this->boundary_vehicles.push_back(n);
+        }
+    }
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::HALO_WAIT);
+        halo_ptr->wait(&(this->lanes));
+    }
+    this->placeIncoming(halo_ptr);
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::GAPS);
+        for (int n : this->boundary_vehicles) {
+            this->vehicles[n]->updateGaps(this->road_ptr);
+            this->vehicles[n]->decideLaneSwitch(this->road_ptr);
+        }
+    }
+    this->boundary_vehicles.clear();
 
-            for (int n = 0; n < (int) this->vehicles.size(); n++) {
-                int time_on_road = this->vehicles[n]->performLaneMove();
-
-                if (time_on_road != 0) {
-                    vehicles_to_remove.push_back(n);
-                    vdata = {
-                        this->vehicles[n]->getVehicleLane(),
-                        this->vehicles[n]->getId(),
-                        this->vehicles[n]->getNewPosition(),
-                        this->vehicles[n]->getSpeed(),
-                        time_on_road
-                    };
-                    send_to_right.push_back(vdata); 
+    // Change lanes all at once, then send the first sites of the segment to the left neighbor, whose last Vehicles need
+    // them for their forward gaps
+    num_vehicles = this->vehicles.size();
+    this->applyLaneSwitches();
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::HALO_POST);
+        halo_ptr->postHead(&(this->lanes));
+    }
+
+    // Update the speeds of the Vehicles that cannot see the right neighbor while its first sites are in flight
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::SPEED);
+        CATS_COUNT(this->profiler_ptr, Profiler::SPEED, num_vehicles);
+#pragma omp parallel for schedule(static)
+        for (int n = 0; n < num_vehicles; n++) {
+            if (this->vehicles[n]->getPrevPosition() < this->interior_end) {
+                this->vehicles[n]->updateForwardGap(this->road_ptr);
+                this->vehicles[n]->updateSpeed(this->road_ptr);
+            }
+        }
+    }
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::HALO_WAIT);
+        halo_ptr->waitHead(&(this->lanes));
+    }
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::SPEED);
+        for (int n = 0; n < num_vehicles; n++) {
+            if (this->vehicles[n]->getPrevPosition() >= this->interior_end) {
+                this->vehicles[n]->updateForwardGap(this->road_ptr);
+                this->vehicles[n]->updateSpeed(this->road_ptr);
+                this->boundary_vehicles.push_back(n);
+            } else {
+                this->addToBlock(n, this->vehicles[n]->getPrevPosition() / this->block_size);
+            }
+        }
+    }
+
+    // Move all the Vehicles, first the even and then the odd active blocks, and last the Vehicles that may leave the
+    // segment
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::MOVE);
+        CATS_COUNT(this->profiler_ptr, Profiler::MOVE, num_vehicles);
+        for (int phase = 0; phase < 2; phase++) {
+            std::vector<int>* active = &(this->active_blocks[phase]);
+#pragma omp parallel for schedule(dynamic)
+            for (int k = 0; k < (int) active->size(); k++) {
+                int b = (*active)[k];
+                for (int n : this->block_vehicles[b]) {
+                    this->vehicles[n]->applyLaneMove(this->road_ptr);
                 }
+                this->block_vehicles[b].clear();
+            }
+            active->clear();
+        }
+        for (int n : this->boundary_vehicles) {
+            int time_on_road = this->vehicles[n]->applyLaneMove(this->road_ptr);
+            if (time_on_road != 0) {
+                this->leaveSegment(this->vehicles[n], time_on_road, halo_ptr);
+                this->vehicles_to_remove.push_back(n);
             }
         }
+    }
+    this->boundary_vehicles.clear();
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Sets up the interior and the blocks of the interior for the number of sites in the segment
+ * @param road_length_per_process number of sites in the segment owned by the process
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::setSegmentSize(int road_length_per_process) {
+    // Vehicles in the first sites can see the Vehicles that arrive from the left and the ghost sites of the left
+    // neighbor, and the Vehicles in the last sites can see the ghost sites of the right neighbor
+    int halo_width = HaloExchange::width(this->inputs);
+    this->interior_begin = this->inputs.max_speed + halo_width;
+    this->interior_end = road_length_per_process - halo_width;
+
+    // The interior is split into blocks of sites that are updated by separate threads. A Vehicle touches the sites from
+    // look_other_backward + 1 behind to max_speed + 2 ahead of it, so blocks that are a whole number of bitset words
+    // and far wider than that never touch the same words when every other block is updated at the same time.
+    int reach = this->inputs.max_speed + this->inputs.look_other_backward + 2;
+    this->block_size = 64 * std::max(16, (reach + 63) / 64);
+    this->block_vehicles.resize((road_length_per_process + this->block_size - 1) / this->block_size);
+
+    // The output locates the segments on the Road and their chunks in its frames from their starts and sizes
+    if (this->frames_ptr != nullptr) {
+        this->frames_ptr->setSegment(this->segment_start, road_length_per_process);
+    }
+    if (this->detectors_ptr != nullptr) {
+        this->detectors_ptr->setSegment(this->segment_start, road_length_per_process);
+    }
+
+    // When the ghost Vehicles are updated as well, the blocks cover the ghost sites, and the Vehicles leave the sites
+    // updated by this process at the end of the ghost zone ahead of the segment, or at the end of the Road
+    if (this->inputs.exchange_interval > 1) {
+        int ghost_width = this->lanes[0]->getGhostWidth();
+        int exit_site = road_length_per_process;
+        if (this->has_right_neighbor) {
+            exit_site += HaloExchange::zoneAhead(this->inputs);
+        }
+        for (int i = 0; i < (int) this->lanes.size(); i++) {
+            this->lanes[i]->setExitSite(exit_site);
+        }
+        this->block_vehicles.resize((road_length_per_process + 2 * ghost_width + this->block_size - 1) /
+                                    this->block_size);
+    }
 
-        if(rank > 0){
-            int send_count;
-            MPI_Recv(&send_count, 1, MPI_INT, neighbor_left, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            send_to_right.resize(send_count); // Resize before receiving
-            MPI_Recv(send_to_right.data(), send_count * sizeof(VehicleData), MPI_BYTE, neighbor_left, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            
-            Vehicle* new_vehicle;
+    // Return with no errors
+    return 0;
+}
 
-            for (const auto& vdata : send_to_right) {
-                for (auto existing_lane : lanes) { 
-                    if (existing_lane->getLaneNumber() == vdata.lane) {
-                        new_vehicle = new Vehicle(existing_lane, vdata.id, vdata.position, this->inputs);
-                    }  
-                }
-                new_vehicle->setSpeed(vdata.speed);
-                new_vehicle->setTimeOnRoad(vdata.time_on_road);
-                local_vehicles.push_back(new_vehicle);
+/**
+ * Completes the exchange in flight and moves the boundaries of the segment to balance the Vehicles between the
+ * processes, then starts the exchange again for the resized segment
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @param balancer_ptr pointer to the LoadBalancer of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::rebalance(HaloExchange* halo_ptr, LoadBalancer* balancer_ptr) {
+    CATS_PROFILE(this->profiler_ptr, Profiler::REBALANCE);
+    this->completeExchange(halo_ptr);
+
+    balancer_ptr->rebalance(this->road_ptr, &(this->vehicles));
+    this->moveSegmentStart(balancer_ptr->getShift());
+    this->setSegmentSize(this->lanes[0]->getSize());
+
+    // Fill the ghost sites of the resized segment, no Vehicles cross the boundaries in this exchange
+    halo_ptr->post(&(this->lanes));
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Moves the first site of the segment on the Road after the boundaries of the segments have moved. The first segment
+ * can hand sites over to the last one on a ring, so the segments may wrap around the end of the ring.
+ * @param shift number of sites that the start of the segment moved back
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::moveSegmentStart(int shift) {
+    this->segment_start = (this->segment_start - shift + this->inputs.length) % this->inputs.length;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Replaces the ghost Vehicles by fresh copies of the Vehicles of the neighbors, every exchange_interval steps. The
+ * Vehicles outside the segment are dropped first, since the neighbors own them, and the boundaries of the segments are
+ * moved at this point if they are due to be rebalanced.
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @param balancer_ptr pointer to the LoadBalancer of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::exchangeGhosts(HaloExchange* halo_ptr, LoadBalancer* balancer_ptr) {
+    CATS_PROFILE(this->profiler_ptr, Profiler::GHOSTS);
+    int segment_size = this->lanes[0]->getSize();
+    for (int n = 0; n < (int) this->vehicles.size(); n++) {
+        int position = this->vehicles[n]->getPrevPosition();
+        if (position < 0 || position >= segment_size) {
+            this->lanes[this->vehicles[n]->getVehicleLane()]->removeVehicle(position);
+            this->vehicles_to_remove.push_back(n);
+        }
+    }
+    this->removeVehicles();
+
+    // Move the boundaries between the segments if a rebalance was due since the last exchange
+    int interval = this->inputs.balance_interval;
+    if (interval > 0 && this->time > 0 && this->time % interval < this->inputs.exchange_interval) {
+        balancer_ptr->rebalance(this->road_ptr, &(this->vehicles));
+        this->moveSegmentStart(balancer_ptr->getShift());
+        segment_size = this->lanes[0]->getSize();
+        this->setSegmentSize(segment_size);
+    }
+
+    // Send copies of the Vehicles in the ghost zones of the neighbors, with the positions relative to their segments
+    int zone_behind = HaloExchange::zoneBehind(this->inputs);
+    int zone_ahead = HaloExchange::zoneAhead(this->inputs);
+    for (int n = 0; n < (int) this->vehicles.size(); n++) {
+        Vehicle* vehicle_ptr = this->vehicles[n];
+        VehicleData vdata = {
+            vehicle_ptr->getVehicleLane(),
+            vehicle_ptr->getId(),
+            vehicle_ptr->getPrevPosition(),
+            vehicle_ptr->getSpeed(),
+            vehicle_ptr->getTimeOnRoad(),
+            vehicle_ptr->getVehicleClass()
+        };
+        int status = 0;
+        if (vdata.position < zone_ahead) {
+            status |= halo_ptr->pushGhost(HaloExchange::LEFT, vdata);
+        }
+        if (vdata.position >= segment_size - zone_behind) {
+            vdata.position -= segment_size;
+            status |= halo_ptr->pushGhost(HaloExchange::RIGHT, vdata);
+        }
+        if (status != 0) {
+            std::cerr << "error: too many ghost vehicles on rank " << this->rank << std::endl;
+            MPI_Abort(this->road_comm, 1);
+        }
+    }
+    halo_ptr->exchangeGhosts();
+    CATS_COUNT(this->profiler_ptr, Profiler::GHOSTS,
+               halo_ptr->getNumGhosts(HaloExchange::LEFT) + halo_ptr->getNumGhosts(HaloExchange::RIGHT));
+
+    // Place the ghost Vehicles in the ghost zones
+    for (int side = 0; side < 2; side++) {
+        int offset = (side == HaloExchange::RIGHT) ? segment_size : 0;
+        for (int n = 0; n < halo_ptr->getNumGhosts((HaloExchange::Side) side); n++) {
+            VehicleData vdata = halo_ptr->getGhost((HaloExchange::Side) side, n);
+            vdata.position += offset;
+            Vehicle* new_vehicle = this->road_ptr->getVehiclePool()->acquire(vdata.lane, vdata.id, vdata.position,
+                                                                             vdata.vehicle_class);
+            new_vehicle->setSpeed(vdata.speed);
+            new_vehicle->setTimeOnRoad(vdata.time_on_road);
+            this->lanes[vdata.lane]->addVehicle(vdata.position);
+            this->vehicles.push_back(new_vehicle);
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Performs one step of the synchronous update without communication, for the Vehicles of the segment and the ghost
+ * Vehicles of the neighbors alike. Ghost Vehicles that leave the ghost zone ahead of the segment are dropped, and only
+ * the Vehicles that leave the end of the Road are counted in the travel time Statistic.
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::stepLocal(HaloExchange* halo_ptr) {
+    int num_vehicles = this->vehicles.size();
+
+    // Decide on the lane changes from the same state, then change lanes all at once
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::GAPS);
+        CATS_COUNT(this->profiler_ptr, Profiler::GAPS, num_vehicles);
+#pragma omp parallel for schedule(static)
+        for (int n = 0; n < num_vehicles; n++) {
+            this->vehicles[n]->updateGaps(this->road_ptr);
+            this->vehicles[n]->decideLaneSwitch(this->road_ptr);
+        }
+    }
+    this->applyLaneSwitches();
+
+    // Update the speeds from the same state
+    {
+        CATS_PROFILE(this->profiler_ptr, Profiler::SPEED);
+        CATS_COUNT(this->profiler_ptr, Profiler::SPEED, num_vehicles);
+#pragma omp parallel for schedule(static)
+        for (int n = 0; n < num_vehicles; n++) {
+            this->vehicles[n]->updateForwardGap(this->road_ptr);
+            this->vehicles[n]->updateSpeed(this->road_ptr);
+        }
+    }
+
+    // Move all the Vehicles, first the even and then the odd blocks, and last the Vehicles that may reach the exit site
+    CATS_PROFILE(this->profiler_ptr, Profiler::MOVE);
+    CATS_COUNT(this->profiler_ptr, Profiler::MOVE, num_vehicles);
+    int ghost_width = this->lanes[0]->getGhostWidth();
+    int exit_zone = this->lanes[0]->getExitSite() - this->inputs.max_speed;
+    for (int n = 0; n < num_vehicles; n++) {
+        int position = this->vehicles[n]->getPrevPosition();
+        if (position >= exit_zone) {
+            this->boundary_vehicles.push_back(n);
+        } else {
+            this->addToBlock(n, (position + ghost_width) / this->block_size);
+        }
+    }
+    for (int phase = 0; phase < 2; phase++) {
+        std::vector<int>* active = &(this->active_blocks[phase]);
+#pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < (int) active->size(); k++) {
+            int b = (*active)[k];
+            for (int n : this->block_vehicles[b]) {
+                this->vehicles[n]->applyLaneMove(this->road_ptr);
+            }
+            this->block_vehicles[b].clear();
+        }
+        active->clear();
+    }
+    for (int n : this->boundary_vehicles) {
+        int time_on_road = this->vehicles[n]->applyLaneMove(this->road_ptr);
+        if (time_on_road != 0) {
+            if (!halo_ptr->hasRightNeighbor()) {
+                this->leaveSegment(this->vehicles[n], time_on_road, halo_ptr);
             }
+            this->vehicles_to_remove.push_back(n);
+        }
+    }
+    this->boundary_vehicles.clear();
 
-            send_to_right.clear();
-
-            for (int i = 0; i < local_vehicles.size(); ++i) {
-                auto vehicle = local_vehicles[i];
-                                                                    
-                vehicle->updateGaps(this->road_ptr);                
-                vehicle->performLaneSwitch(this->road_ptr);         
-                vehicle->updateGaps(this->road_ptr);
-
-                int prev_pos = vehicle->getPrevPosition();                                       
-                int time_on_road = vehicle->performLaneMove();   
-                int new_pos = vehicle->getNewPosition();
-                
-                if (time_on_road != 0) {
-                    if(prev_pos + new_pos < road_length_per_process + this->inputs.max_speed ){
-                        vdata = {
-                            vehicle->getVehicleLane(), 
-                            vehicle->getId(), 
-                            new_pos, 
-                            vehicle->getSpeed(),
-                            time_on_road
-                        };
-                        vehicle->setTempPosition(road_length_per_process);
-                    }else{
-                        vdata = {
-                            vehicle->getVehicleLane(),
-                            vehicle->getId(),
-                            new_pos,
-                            vehicle->getSpeed(),
-                            time_on_road
-                        };
-                        local_vehicles_to_remove.push_back(i);
-                        vehicle->getLane()->removeVehicle(new_pos);
-                    }
-                    send_to_right.push_back(vdata);   
-                }
+    // Return with no errors
+    return 0;
+}
 
-                // Remove and delete vehicles in reverse order to avoid invalidating indices
-                std::sort(local_vehicles_to_remove.rbegin(), local_vehicles_to_remove.rend());
-                for (int index : local_vehicles_to_remove) {
-                    if (this->time > this->inputs.warmup_time) {
-                        this->travel_time->addValue(local_vehicles[index]->getTravelTime(this->inputs));
-                    }
-                    delete local_vehicles[index];
-                    local_vehicles.erase(local_vehicles.begin() + index);
+/**
+ * Fills the segment of a ring with Vehicles at the start of the simulation, spread evenly over the sites so that
+ * percent_full percent of the sites in every Lane are occupied. The sites that are occupied only depend on their
+ * position on the whole Road, and the Vehicle ids are numbered by Lane and site, so the Vehicles do not depend on how
+ * the Road is partitioned. The class of a Vehicle is picked with a draw keyed on its id. The segment is located on the
+ * Road by the first site set by the caller, and may wrap around the end of the ring.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::placeVehicles() {
+    // A site is occupied when the number of Vehicles in the sites up to it reaches the next whole number
+    int segment_size = this->lanes[0]->getSize();
+    double fill = this->inputs.percent_full / 100.0;
+    VehicleStore* store_ptr = this->road_ptr->getVehicleStore();
+    for (int i = 0; i < (int) this->lanes.size(); i++) {
+        for (int site = 0; site < segment_size; site++) {
+            long long g = (this->segment_start + site) % this->inputs.length;
+            if (std::floor((g + 1) * fill) > std::floor(g * fill)) {
+                int id = (int) (i * (long long) this->inputs.length + g);
+                int vehicle_class = 0;
+                if (store_ptr->classes.size() > 1) {
+                    double uniform = this->road_ptr->getRandom()->uniform(Random::VEHICLE_CLASS, id);
+                    vehicle_class = store_ptr->pickClass(uniform);
                 }
-                local_vehicles_to_remove.clear();
+                this->vehicles.push_back(this->road_ptr->getVehiclePool()->acquire(i, id, site, vehicle_class));
+                this->lanes[i]->addVehicle(site);
             }
         }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Adds the speeds of the Vehicles in the segment to the speed Statistic, leaving out the ghost Vehicles that are owned
+ * by the neighbors
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::recordSpeeds() {
+    int segment_size = this->lanes[0]->getSize();
+    for (Vehicle* vehicle_ptr : this->vehicles) {
+        int position = vehicle_ptr->getPrevPosition();
+        if (position >= 0 && position < segment_size) {
+            this->speed->addValue(vehicle_ptr->getSpeed());
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
 
-        if (neighbor_right < size){
-            int send_count = send_to_right.size();
-            MPI_Send(&send_count, 1, MPI_INT, neighbor_right, 0, MPI_COMM_WORLD);
-            MPI_Send(send_to_right.data(), send_count * sizeof(VehicleData), MPI_BYTE, neighbor_right, 0, MPI_COMM_WORLD);
-            send_to_right.clear();
+/**
+ * Adds the Vehicles in the segment to the digest of the step, leaving out the ghost Vehicles that are owned by the
+ * neighbors. The Vehicles that were handed over to the right neighbor in the step were added when they left.
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::digestStep() {
+    if (this->device_ptr != nullptr) {
+        this->device_ptr->fetch();
+    }
+    int segment_size = this->lanes[0]->getSize();
+    for (Vehicle* vehicle_ptr : this->vehicles) {
+        int position = vehicle_ptr->getPrevPosition();
+        if (position >= 0 && position < segment_size) {
+            this->digest_ptr->addVehicle(vehicle_ptr->getId(), vehicle_ptr->getVehicleLane(),
+                                         this->segment_start + position, vehicle_ptr->getSpeed(),
+                                         vehicle_ptr->getTimeOnRoad());
+        }
+    }
+    this->digest_ptr->endStep();
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Writes the state of the simulation to the checkpoint file. The exchange in flight is completed first, so that the
+ * Vehicles that crossed to the right neighbor are saved by the process that owns them, and is started again afterwards.
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @param checkpoint_ptr pointer to the Checkpoint of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::writeCheckpoint(HaloExchange* halo_ptr, Checkpoint* checkpoint_ptr) {
+    CATS_PROFILE(this->profiler_ptr, Profiler::CHECKPOINT);
+
+    // When the ghost Vehicles are updated as well, no exchange is in flight, but the device engine may have the
+    // Vehicles on the device
+    bool local = this->inputs.exchange_interval > 1;
+    if (!local) {
+        this->completeExchange(halo_ptr);
+    } else if (this->device_ptr != nullptr) {
+        this->device_ptr->fetch();
+    }
+
+    CheckpointState state = {this->time, this->next_id, this->num_placed};
+    std::string path = this->inputs.getPath("cats-checkpoint.dat");
+    if (checkpoint_ptr->write(path, state, this->segment_start, this->road_ptr, &(this->vehicles), this->travel_time,
+                              this->speed) != 0) {
+        MPI_Abort(this->road_comm, 1);
+    }
+
+    if (!local) {
+        halo_ptr->post(&(this->lanes));
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Writes a frame with the state of the Road to the output file. As for a checkpoint, the exchange in flight is
+ * completed first and started again afterwards, while the frame itself is written in the background.
+ * @param halo_ptr pointer to the HaloExchange with the neighbors of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::writeFrame(HaloExchange* halo_ptr) {
+    CATS_PROFILE(this->profiler_ptr, Profiler::OUTPUT);
+    bool local = this->inputs.exchange_interval > 1;
+    if (!local) {
+        this->completeExchange(halo_ptr);
+    } else if (this->device_ptr != nullptr) {
+        this->device_ptr->fetch();
+    }
+
+    if (this->frames_ptr->write(this->time, this->road_ptr, &(this->vehicles)) != 0) {
+        MPI_Abort(this->road_comm, 1);
+    }
+
+    if (!local) {
+        halo_ptr->post(&(this->lanes));
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Restarts the simulation from the checkpoint file, on an empty Road
+ * @param checkpoint_ptr pointer to the Checkpoint of the segment
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::readCheckpoint(Checkpoint* checkpoint_ptr) {
+    CheckpointState state;
+    std::string path = this->inputs.getPath("cats-checkpoint.dat");
+    if (checkpoint_ptr->read(path, &state, &(this->segment_start), this->road_ptr, &(this->vehicles),
+                             this->travel_time, this->speed) != 0) {
+        MPI_Abort(this->road_comm, 1);
+    }
+    this->time = state.time;
+    this->next_id = state.next_id;
+    this->num_placed = state.num_placed;
+    if (this->rank == 0) {
+        std::cout << "restarting from step " << this->time << std::endl;
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Executes the simulation on the segment of the Road owned by this process
+ * @param road_comm Cartesian communicator of the segments of the Road, periodic if the Road is a ring
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::run_simulation(MPI_Comm road_comm) {
+
+    int rank;
+    MPI_Comm_rank(road_comm, &rank);
+    this->rank = rank;
+    this->road_comm = road_comm;
+
+    std::chrono::steady_clock::time_point begin;
+
+    begin = std::chrono::steady_clock::now();
+
+    // Set the simulation time to zero
+    this->time = 0;
+
+    // Create the exchange with the neighboring segments
+    HaloExchange halo(this->inputs, road_comm);
+    this->has_right_neighbor = halo.hasRightNeighbor();
+
+    // Create the balancer that moves the boundaries between the segments
+    LoadBalancer balancer(this->inputs, road_comm);
+
+    // Create the checkpoint that saves the state of the simulation every checkpoint_interval steps
+    Checkpoint checkpoint(this->inputs, road_comm);
+
+    // Create the output of the state of the Road every output_interval steps
+    if (this->inputs.output_interval > 0) {
+        this->frames_ptr = new FrameWriter(this->inputs, road_comm);
+        if (this->frames_ptr->open(this->inputs.getPath("cats-output.dat")) != 0) {
+            MPI_Abort(this->road_comm, 1);
+        }
+    }
+
+    // Create the detectors that count the Vehicles as they move, reduced every detector_interval steps
+    if (this->inputs.detector_interval > 0) {
+        this->detectors_ptr = new Detectors(this->inputs, road_comm);
+        if (this->detectors_ptr->open(this->inputs.getPath("cats-detectors.csv")) != 0) {
+            MPI_Abort(this->road_comm, 1);
+        }
+        this->road_ptr->setDetectors(this->detectors_ptr);
+    }
+
+    // Create the device engine that updates the Vehicles between the exchanges of the ghost Vehicles
+    if (this->inputs.device) {
+        this->device_ptr = new DeviceEngine(this->inputs, this->road_ptr);
+        if (rank == 0 && DeviceEngine::getNumDevices() == 0) {
+            std::cerr << "warning: no offload device, the device engine runs on the host" << std::endl;
+        }
+    }
+
+    // Continue from the checkpoint, which may also move and resize the segment. Otherwise a ring has no start for the
+    // Vehicles to spawn at, so it is filled with the Vehicles at the start instead.
+    this->num_placed = 0;
+    int segment_size = this->lanes[0]->getSize();
+    if (this->inputs.restart) {
+        this->readCheckpoint(&checkpoint);
+        segment_size = this->lanes[0]->getSize();
+    } else {
+        this->segment_start = 0;
+        MPI_Exscan(&segment_size, &(this->segment_start), 1, MPI_INT, MPI_SUM, road_comm);
+        if (rank == 0) {
+            this->segment_start = 0;
+        }
+        if (this->inputs.periodic) {
+            this->placeVehicles();
+            this->num_placed = (int) this->vehicles.size();
+            MPI_Allreduce(MPI_IN_PLACE, &(this->num_placed), 1, MPI_INT, MPI_SUM, road_comm);
+        }
+    }
+    this->setSegmentSize(segment_size);
+    int start_time = this->time;
+
+    // Start with an empty exchange so that every step can complete the exchange of the previous one, unless the
+    // Vehicles are only exchanged every exchange_interval steps
+    bool local = this->inputs.exchange_interval > 1;
+    if (!local) {
+        halo.post(&(this->lanes));
+    }
+
+    // Write the state at the start of the simulation
+    if (this->frames_ptr != nullptr && this->time % this->inputs.output_interval == 0) {
+        this->writeFrame(&halo);
+    }
+
+#ifdef CATS_TRACE
+    this->profiler_ptr->start(road_comm);
+#endif
+    while (this->time < this->inputs.max_time) {
+        CATS_PROFILE(this->profiler_ptr, Profiler::STEP);
+
+        // Draw the random numbers of this step
+        this->road_ptr->getRandom()->setStep(this->time);
+
+        // Update all the Vehicles of the segment
+        if (local) {
+            // The ghost Vehicles are not saved in a checkpoint, so they are exchanged again on a restart. The device
+            // engine keeps the Vehicles on the device from one exchange to the next.
+            if (this->time % this->inputs.exchange_interval == 0 || this->time == start_time) {
+                if (this->device_ptr != nullptr) {
+                    this->device_ptr->release();
+                }
+                this->exchangeGhosts(&halo, &balancer);
+                if (this->device_ptr != nullptr) {
+                    this->device_ptr->upload(&(this->vehicles));
+                }
+            }
+            if (this->device_ptr != nullptr) {
+                CATS_PROFILE(this->profiler_ptr, Profiler::DEVICE);
+                CATS_COUNT(this->profiler_ptr, Profiler::DEVICE, this->vehicles.size());
+                this->device_ptr->step(&(this->vehicles), &(this->vehicles_to_remove));
+            } else {
+                this->stepLocal(&halo);
+            }
+        } else {
+            if (this->inputs.synchronous) {
+                this->stepSynchronous(&halo);
+            } else {
+                this->stepSequential(&halo);
+            }
+
+            // Send the halos to the neighbors and start the exchange
+            CATS_PROFILE(this->profiler_ptr, Profiler::HALO_POST);
+            halo.post(&(this->lanes));
         }
 
         // End of iteration steps
         // Increment time
         this->time++;
 
-        if(rank == 0){
-            // Remove finished vehicles
-            std::sort(vehicles_to_remove.begin(), vehicles_to_remove.end());
-            for (int i = vehicles_to_remove.size() - 1; i >= 0; i--) {
-                // Update travel time statistic if beyond warm-up period
-                if (this->time > this->inputs.warmup_time) {
-                    this->travel_time->addValue(this->vehicles[vehicles_to_remove[i]]->getTravelTime(this->inputs));
-                }
+        // Remove finished vehicles
+        {
+            CATS_PROFILE(this->profiler_ptr, Profiler::REMOVE);
+            CATS_COUNT(this->profiler_ptr, Profiler::REMOVE, this->vehicles_to_remove.size());
+            this->removeVehicles();
+        }
 
-                // Delete the Vehicle
-                delete this->vehicles[vehicles_to_remove[i]];
-                this->vehicles.erase(this->vehicles.begin() + vehicles_to_remove[i]);
+        // Spawn new Vehicles at the start of the Road, or measure the speeds of the Vehicles on a ring
+        if (this->inputs.periodic) {
+            if (this->time > this->inputs.warmup_time) {
+                if (this->device_ptr != nullptr) {
+                    this->device_ptr->fetchSpeeds();
+                }
+                this->recordSpeeds();
             }
-            vehicles_to_remove.clear();
-
-            // Spawn new Vehicles
+        } else if (rank == 0) {
+            CATS_PROFILE(this->profiler_ptr, Profiler::SPAWN);
             this->road_ptr->attemptSpawn(this->inputs, &(this->vehicles), &(this->next_id));
         }
+
+        // Add the state at the end of the step to the digest of the run
+        if (this->digest_ptr != nullptr) {
+            this->digestStep();
+        }
+
+        // Reduce the counts of the detectors every detector_interval steps
+        if (this->detectors_ptr != nullptr && this->time % this->inputs.detector_interval == 0) {
+            CATS_PROFILE(this->profiler_ptr, Profiler::DETECTORS);
+            this->detectors_ptr->reduce(this->time);
+        }
+
+        // Move the boundaries between the segments every balance_interval steps
+        if (!local && this->inputs.balance_interval > 0 && this->time % this->inputs.balance_interval == 0) {
+            this->rebalance(&halo, &balancer);
+        }
+
+        // Save the state of the simulation every checkpoint_interval steps
+        if (this->inputs.checkpoint_interval > 0 && this->time % this->inputs.checkpoint_interval == 0) {
+            this->writeCheckpoint(&halo, &checkpoint);
+        }
+
+        // Write the state of the Road every output_interval steps
+        if (this->frames_ptr != nullptr && this->time % this->inputs.output_interval == 0) {
+            this->writeFrame(&halo);
+        }
     }
 
-    MPI_Barrier(MPI_COMM_WORLD);
-
-    double average = this->travel_time->getAverage();
-    double variance = this->travel_time->getVariance();
-    int numSamples = this->travel_time->getNumSamples();
-
-    if (rank > 0) {
-        // Pack the data into an array
-        double data[3] = {average, variance, static_cast<double>(numSamples)};
-        // Send to rank 0
-        MPI_Send(data, 3, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
-    }else {
-        // Initialize totals with rank 0's values
-        double total_sum = average * numSamples;
-        double total_samples = numSamples;
-        double total_squared_sum = variance * numSamples + average * average * numSamples;
-
-        // Receive and accumulate data from other ranks
-        for (int source = 1; source < size; source++) {
-            double received_data[3];
-            MPI_Recv(received_data, 3, MPI_DOUBLE, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            
-            // Add to totals
-            total_samples += received_data[2];
-            total_sum += received_data[0] * received_data[2];
-            total_squared_sum += (received_data[1] * received_data[2]) + 
-                                (received_data[0] * received_data[0] * received_data[2]);
-        }
-
-        // Calculate final statistics
-        double final_average = total_sum / total_samples;
-        double final_variance = (total_squared_sum / total_samples) - 
-                            (final_average * final_average);
-
-        // Print the total run time and average iterations per second and seconds per iteration
-        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-        auto time_elapsed = (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) /1000000.0;
-        std::cout << "--- Simulation Performance ---" << std::endl;
-        std::cout << "total computation time: " << time_elapsed << " [s]" << std::endl;
-        std::cout << "average time per iteration: " << time_elapsed / inputs.max_time << " [s]" << std::endl;
-        std::cout << "average iterating frequency: " << inputs.max_time / time_elapsed << " [iter/s]" << std::endl;
-
-        std::cout << "--- Combined Statistics Across All Processes ---" << std::endl;
-        std::cout << "time on road: avg=" << final_average 
-                << ", std=" << pow(final_variance, 0.5) 
-                << ", N=" << static_cast<int>(total_samples) 
-                << std::endl;
+    // Complete the last exchange, the Vehicles still in flight are not counted
+    if (!local) {
+        halo.wait(&(this->lanes));
+    } else if (this->device_ptr != nullptr) {
+        this->device_ptr->release();
+    }
 
+    // Complete the writes of the last frames and the last reduction of the detectors
+    if (this->frames_ptr != nullptr) {
+        this->frames_ptr->close();
+    }
+    if (this->detectors_ptr != nullptr) {
+        this->detectors_ptr->close();
     }
-    MPI_Finalize();
+
+    MPI_Barrier(road_comm);
+
+    // Measure the run time of the simulation and the time that this process spent communicating with the others
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    this->elapsed_time = (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) / 1000000.0;
+    this->communication_time = halo.getCommunicationTime() + balancer.getCommunicationTime();
+
+    // Combine the digests of all the processes
+    if (this->digest_ptr != nullptr) {
+        this->digest_ptr->reduce(road_comm);
+    }
+
+    // Combine the travel time statistics of all the processes on rank 0
+    this->travel_time->reduce(0, road_comm);
+    if (this->inputs.periodic) {
+        this->speed->reduce(0, road_comm);
+    }
+
+#ifdef CATS_TRACE
+    // Write the timelines of the phases and print their summary, after the run time has been measured
+    this->profiler_ptr->report(road_comm, this->inputs.getPath("cats-trace.json"));
+#endif
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Prints the performance of the simulation and the statistics combined across all the processes, on rank 0 after
+ * run_simulation
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::printResults() {
+    // Print the total run time and average iterations per second and seconds per iteration
+    double time_elapsed = this->elapsed_time;
+    std::cout << "--- Simulation Performance ---" << std::endl;
+    std::cout << "total computation time: " << time_elapsed << " [s]" << std::endl;
+    std::cout << "average time per iteration: " << time_elapsed / inputs.max_time << " [s]" << std::endl;
+    std::cout << "average iterating frequency: " << inputs.max_time / time_elapsed << " [iter/s]" << std::endl;
+#ifdef _OPENMP
+    std::cout << "threads per process: " << omp_get_max_threads() << std::endl;
+#endif
+
+    std::cout << "--- Combined Statistics Across All Processes ---" << std::endl;
+    if (this->inputs.periodic) {
+        // The flow through a site of a Lane is the density of the Vehicles times their average speed
+        double density = this->num_placed / ((double) this->inputs.num_lanes * this->inputs.length);
+        std::cout << "ring: vehicles=" << this->num_placed << ", density=" << density << " [vehicles/site]"
+                  << std::endl;
+        std::cout << "speed: avg=" << this->speed->getAverage()
+                  << ", std=" << pow(this->speed->getVariance(), 0.5)
+                  << ", N=" << this->speed->getNumSamples()
+                  << std::endl;
+        std::cout << "flow: " << density * this->speed->getAverage() << " [vehicles/step/lane]" << std::endl;
+    } else {
+        std::cout << "time on road: avg=" << this->travel_time->getAverage()
+                << ", std=" << pow(this->travel_time->getVariance(), 0.5)
+                << ", N=" << this->travel_time->getNumSamples()
+                << std::endl;
+        if (this->travel_time->hasQuantiles()) {
+            std::cout << "time on road: p50=" << this->travel_time->getQuantile(0.5)
+                      << ", p90=" << this->travel_time->getQuantile(0.9)
+                      << ", p99=" << this->travel_time->getQuantile(0.99)
+                      << std::endl;
+        }
+    }
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the run time of the simulation, measured by run_simulation
+ * @return run time in seconds
+ */
+double Simulation::getElapsedTime() {
+    return this->elapsed_time;
+}
+
+/**
+ * Getter for the time that this process spent communicating with the other processes during run_simulation,
+ * including the time spent waiting for them
+ * @return communication time in seconds
+ */
+double Simulation::getCommunicationTime() {
+    return this->communication_time;
+}
+
+/**
+ * Getter for the number of Vehicles placed on a ring at the start of the simulation, on all the processes
+ * @return number of Vehicles on the ring
+ */
+int Simulation::getNumPlaced() {
+    return this->num_placed;
+}
+
+/**
+ * Getter for the travel time Statistic, combined across all the processes on rank 0 after run_simulation
+ * @return pointer to the travel time Statistic
+ */
+Statistic* Simulation::getTravelTime() {
+    return this->travel_time;
+}
+
+/**
+ * Getter for the speed Statistic of a ring, combined across all the processes on rank 0 after run_simulation
+ * @return pointer to the speed Statistic
+ */
+Statistic* Simulation::getSpeed() {
+    return this->speed;
+}
+
+/**
+ * Setter for the digest of the state of the Road at every step, which is owned by the caller
+ * @param digest_ptr pointer to the StateDigest, or nullptr to not digest the steps
+ * @return 0 if successful, nonzero otherwise
+ */
+int Simulation::setDigest(StateDigest* digest_ptr) {
+    this->digest_ptr = digest_ptr;
 
     // Return with no errors
     return 0;
@@ -6,27 +6,85 @@
 #define CA_TRAFFIC_SIMULATION_SIMULATION_H
 
 #include <vector>
+#include <mpi.h>
 
 #include "Road.h"
 #include "Inputs.h"
 #include "Statistic.h"
+#include "HaloExchange.h"
+#include "LoadBalancer.h"
+#include "Checkpoint.h"
+#include "FrameWriter.h"
+#include "Profiler.h"
+#include "Detectors.h"
+#include "DeviceEngine.h"
+#include "StateDigest.h"
 
 /**
- * Class for the simulation. Has a method for running the simulation.
+ * Class for the simulation. Has a method for running the simulation, with either the sequential or the synchronous
+ * update of the Vehicles, on an open Road with Vehicles spawning at the start or on a ring filled at the start. The
+ * synchronous update of a ring can also run on an offload device with the DeviceEngine.
  */
 class Simulation {
 private:
     Road* road_ptr;
+    std::vector<Lane*> lanes;
     int time;
     std::vector<Vehicle*> vehicles;
     Inputs inputs;
     int next_id;
     Statistic* travel_time;
+    Statistic* speed;
+    Profiler* profiler_ptr;
+    FrameWriter* frames_ptr;
+    Detectors* detectors_ptr;
+    DeviceEngine* device_ptr;
+    StateDigest* digest_ptr;
     int rank;
+    MPI_Comm road_comm;
+    bool has_right_neighbor;
+    int num_placed;
+    double elapsed_time;
+    double communication_time;
+    int segment_start;
+    int interior_begin;
+    int interior_end;
+    int block_size;
+    std::vector<std::vector<int>> block_vehicles;
+    std::vector<int> active_blocks[2];
+    std::vector<int> boundary_vehicles;
+    std::vector<int> vehicles_to_remove;
+    int leaveSegment(Vehicle* vehicle_ptr, int time_on_road, HaloExchange* halo_ptr);
+    bool stepVehicle(Vehicle* vehicle_ptr, HaloExchange* halo_ptr);
+    int placeIncoming(HaloExchange* halo_ptr);
+    int removeVehicles();
+    int completeExchange(HaloExchange* halo_ptr);
+    int addToBlock(int n, int block);
+    int stepSequential(HaloExchange* halo_ptr);
+    int applyLaneSwitches();
+    int stepSynchronous(HaloExchange* halo_ptr);
+    int setSegmentSize(int road_length_per_process);
+    int rebalance(HaloExchange* halo_ptr, LoadBalancer* balancer_ptr);
+    int moveSegmentStart(int shift);
+    int exchangeGhosts(HaloExchange* halo_ptr, LoadBalancer* balancer_ptr);
+    int stepLocal(HaloExchange* halo_ptr);
+    int placeVehicles();
+    int recordSpeeds();
+    int digestStep();
+    int writeCheckpoint(HaloExchange* halo_ptr, Checkpoint* checkpoint_ptr);
+    int readCheckpoint(Checkpoint* checkpoint_ptr);
+    int writeFrame(HaloExchange* halo_ptr);
 public:
     Simulation(Inputs inputs, int road_length_per_process);
     ~Simulation();
-    int run_simulation(int rank, int size, int road_length_per_process);
+    int run_simulation(MPI_Comm road_comm);
+    int printResults();
+    double getElapsedTime();
+    double getCommunicationTime();
+    int getNumPlaced();
+    Statistic* getTravelTime();
+    Statistic* getSpeed();
+    int setDigest(StateDigest* digest_ptr);
 };
 
 
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <algorithm>
+
+#include "StateDigest.h"
+
+/**
+ * Constructor for an empty StateDigest
+ * @param inputs instance of the Inputs class with simulation inputs
+ */
+StateDigest::StateDigest(Inputs inputs) {
+    this->inputs = inputs;
+    this->step_hash = 0;
+    this->step_count = 0;
+    std::fill(this->totals, this->totals + 6, 0);
+}
+
+/**
+ * Ends the current step, keeping its hash and its number of Vehicles, and starts the next one
+ * @return 0 if successful, nonzero otherwise
+ */
+int StateDigest::endStep() {
+    this->hashes.push_back(this->step_hash);
+    this->counts.push_back(this->step_count);
+    this->totals[VEHICLE_STEPS] += this->step_count;
+    this->step_hash = 0;
+    this->step_count = 0;
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Adds up the digests of all the processes of a run, which then have the digest of the whole Road. Has to be called
+ * by all the processes after the same number of steps.
+ * @param comm communicator of the processes of the run
+ * @return 0 if successful, nonzero otherwise
+ */
+int StateDigest::reduce(MPI_Comm comm) {
+    MPI_Allreduce(MPI_IN_PLACE, this->hashes.data(), this->hashes.size(), MPI_UINT64_T, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, this->counts.data(), this->counts.size(), MPI_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, this->totals, 6, MPI_LONG_LONG, MPI_SUM, comm);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the number of steps in the digest
+ * @return number of steps
+ */
+int StateDigest::getNumSteps() {
+    return this->hashes.size();
+}
+
+/**
+ * Getter for the hash of the state of the Road at the end of a step
+ * @param step the step, counted from the first step of the digest
+ * @return the hash of the step
+ */
+uint64_t StateDigest::getHash(int step) {
+    return this->hashes[step];
+}
+
+/**
+ * Getter for the number of Vehicles on the Road at the end of a step
+ * @param step the step, counted from the first step of the digest
+ * @return the number of Vehicles
+ */
+long long StateDigest::getCount(int step) {
+    return this->counts[step];
+}
+
+/**
+ * Getter for one of the sums of the digest over all the steps
+ * @param total the sum
+ * @return the value of the sum
+ */
+long long StateDigest::getTotal(Total total) {
+    return this->totals[total];
+}
+
+/**
+ * Combines the hashes of all the steps and the sums into one hash, which depends on the order of the steps
+ * @return the hash of the whole digest
+ */
+uint64_t StateDigest::getFinalHash() {
+    uint64_t hash = 0;
+    for (uint64_t step_hash : this->hashes) {
+        hash = mix(hash ^ step_hash);
+    }
+    for (long long total : this->totals) {
+        hash = mix(hash ^ (uint64_t) total);
+    }
+    return hash;
+}
+
+/**
+ * Compares the digest with the digest of another run of the same scenario
+ * @param other_ptr pointer to the other digest
+ * @return the first step at which the digests differ, the number of steps if only the sums differ, or -1 if they are
+ *         the same
+ */
+int StateDigest::findMismatch(StateDigest* other_ptr) {
+    int num_steps = std::min(this->hashes.size(), other_ptr->hashes.size());
+    for (int step = 0; step < num_steps; step++) {
+        if (this->hashes[step] != other_ptr->hashes[step] || this->counts[step] != other_ptr->counts[step]) {
+            return step;
+        }
+    }
+    if (this->hashes.size() != other_ptr->hashes.size() || !std::equal(this->totals, this->totals + 6,
+                                                                        other_ptr->totals)) {
+        return num_steps;
+    }
+    return -1;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_STATEDIGEST_H
+#define CA_TRAFFIC_SIMULATION_STATEDIGEST_H
+
+#include <vector>
+#include <cstdint>
+#include <mpi.h>
+
+#include "Inputs.h"
+
+/**
+ * Class for a digest of the state of the Road at every step, for checking that two runs simulate the same Vehicles.
+ * The hash of a step is the sum of the hashes of the Vehicles, each a hash of the id, the Lane, the site on the whole
+ * Road, the speed and the time on road of the Vehicle, so the hash of a step does not depend on the order of the
+ * Vehicles or on the partitioning of the Road, and the sums of all the processes are added up by reduce. The speeds of
+ * the Vehicles and the times on road of the Vehicles that left the Road are summed as integers, so the statistics of
+ * two runs that simulate the same Vehicles are the same to the last bit.
+ */
+class StateDigest {
+private:
+    Inputs inputs;
+    std::vector<uint64_t> hashes;
+    std::vector<long long> counts;
+    uint64_t step_hash;
+    long long step_count;
+    long long totals[6];
+
+    /**
+     * Mixes the bits of a word with the finalizer of SplitMix64
+     * @param x the word
+     * @return the mixed word
+     */
+    static inline uint64_t mix(uint64_t x) {
+        x += UINT64_C(0x9E3779B97F4A7C15);
+        x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+        x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+        return x ^ (x >> 31);
+    }
+public:
+    /**
+     * Sums of the digest over all the steps
+     */
+    enum Total {
+        VEHICLE_STEPS = 0,
+        SPEED_SUM = 1,
+        SPEED_SQUARES = 2,
+        NUM_LEFT = 3,
+        TRAVEL_SUM = 4,
+        TRAVEL_SQUARES = 5
+    };
+
+    StateDigest(Inputs inputs);
+    int endStep();
+    int reduce(MPI_Comm comm);
+    int getNumSteps();
+    uint64_t getHash(int step);
+    long long getCount(int step);
+    long long getTotal(Total total);
+    uint64_t getFinalHash();
+    int findMismatch(StateDigest* other_ptr);
+
+    /**
+     * Adds a Vehicle to the hash of the current step
+     * @param id the id of the Vehicle
+     * @param lane the Lane of the Vehicle
+     * @param site the site of the Vehicle on the whole Road, past the end of a ring if it crossed it
+     * @param speed the speed of the Vehicle
+     * @param time_on_road the time on road of the Vehicle
+     */
+    inline void addVehicle(int id, int lane, int site, int speed, int time_on_road) {
+        if (site >= this->inputs.length) {
+            site -= this->inputs.length;
+        }
+        uint64_t hash = mix((uint32_t) id);
+        hash = mix(hash ^ (((uint64_t) (uint32_t) lane << 32) | (uint32_t) site));
+        hash = mix(hash ^ (((uint64_t) (uint32_t) speed << 32) | (uint32_t) time_on_road));
+        this->step_hash += hash;
+        this->step_count++;
+        this->totals[SPEED_SUM] += speed;
+        this->totals[SPEED_SQUARES] += (long long) speed * speed;
+    }
+
+    /**
+     * Adds a Vehicle that left the end of the Road to the sums of the times on road
+     * @param time_on_road the time on road of the Vehicle
+     */
+    inline void addDeparture(int time_on_road) {
+        this->totals[NUM_LEFT]++;
+        this->totals[TRAVEL_SUM] += time_on_road;
+        this->totals[TRAVEL_SQUARES] += (long long) time_on_road * time_on_road;
+    }
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_STATEDIGEST_H
@@ -3,9 +3,24 @@
  */
 
 #include <cmath>
+#include <limits>
+#include <algorithm>
 #include "Statistic.h"
 
-Statistic::Statistic() {}
+/**
+ * Constructor for the Statistic
+ * @param track_quantiles whether or not to estimate the quantiles of the samples
+ */
+Statistic::Statistic(bool track_quantiles) {
+    this->count = 0.0;
+    this->mean = 0.0;
+    this->m2 = 0.0;
+    this->min_value = std::numeric_limits<double>::infinity();
+    this->max_value = -std::numeric_limits<double>::infinity();
+    if (track_quantiles) {
+        this->histogram.assign(Statistic::SKETCH_BUCKETS, 0.0);
+    }
+}
 
 Statistic::~Statistic() {}
 
@@ -14,8 +29,23 @@ Statistic::~Statistic() {}
  * @param value value of the sample
  */
 void Statistic::addValue(double value) {
-    // Add the value to the vector of values
-    this->values.push_back(value);
+    // Update the moments with Welford's method
+    this->count += 1.0;
+    double delta = value - this->mean;
+    this->mean += delta / this->count;
+    this->m2 += delta * (value - this->mean);
+    this->min_value = std::min(this->min_value, value);
+    this->max_value = std::max(this->max_value, value);
+
+    // Count the value in its bucket of the histogram, small values go in the first bucket and large ones in the last
+    if (!this->histogram.empty()) {
+        int bucket = 0;
+        if (value > Statistic::SKETCH_MIN) {
+            bucket = (int) (std::log(value / Statistic::SKETCH_MIN) / std::log(Statistic::SKETCH_GROWTH));
+            bucket = std::min(bucket, Statistic::SKETCH_BUCKETS - 1);
+        }
+        this->histogram[bucket] += 1.0;
+    }
 }
 
 /**
@@ -23,16 +53,7 @@ void Statistic::addValue(double value) {
  * @return average of the samples in the Statistic
  */
 double Statistic::getAverage() {
-    // Initialize a sum for the average
-    double sum = 0.0;
-
-    // Add each value in the vector of values to the sum
-    for (int i = 0; i < (int) this->values.size(); i++) {
-        sum += this->values[i];
-    }
-
-    // Divide the sum by the number of points and return the average
-    return sum / (double) this->values.size();
+    return this->mean;
 }
 
 /**
@@ -40,25 +61,149 @@ double Statistic::getAverage() {
  * @return variance of the samples in the Statistic
  */
 double Statistic::getVariance() {
-    // Obtain average
-    double avg = this->getAverage();
+    // Divide the sum of squares by the number of points minus 1 and return the variance
+    return (this->count > 1.0) ? this->m2 / (this->count - 1.0) : 0.0;
+}
 
-    // Initialize a sum for the variance
-    double sum = 0.0;
+/**
+ * Gets the number of samples that have been added to the Statistic
+ * @return number of samples in the Statistic
+ */
+int Statistic::getNumSamples() {
+    return (int) this->count;
+}
+
+/**
+ * Checks if the Statistic estimates the quantiles of the samples
+ * @return whether or not the quantiles are estimated
+ */
+bool Statistic::hasQuantiles() {
+    return !this->histogram.empty();
+}
 
-    // Add each value in the vector of values to the sum
-    for (int i = 0; i < (int) this->values.size(); i++) {
-        sum += pow(this->values[i] - avg, 2);
+/**
+ * Estimates a quantile of the samples from the histogram, as the geometric middle of the bucket that holds the quantile
+ * @param q the fraction of the samples below the quantile, in [0, 1]
+ * @return estimate of the quantile, or zero if the quantiles are not estimated or there are no samples
+ */
+double Statistic::getQuantile(double q) {
+    if (this->histogram.empty() || this->count == 0.0) {
+        return 0.0;
     }
+    double target = q * this->count;
+    double cumulative = 0.0;
+    int bucket = 0;
+    for (; bucket < Statistic::SKETCH_BUCKETS - 1; bucket++) {
+        cumulative += this->histogram[bucket];
+        if (cumulative >= target && cumulative > 0.0) {
+            break;
+        }
+    }
+    double value = Statistic::SKETCH_MIN * std::pow(Statistic::SKETCH_GROWTH, bucket + 0.5);
+    return std::max(this->min_value, std::min(this->max_value, value));
+}
+
+/**
+ * Gets the number of doubles that the Statistic is packed into
+ * @return number of doubles, the moments followed by the histogram
+ */
+int Statistic::getPackedSize() {
+    return 5 + this->histogram.size();
+}
 
-    // Divide the sum by the number of points minus 1 and return the variance
-    return sum / ((double) this->values.size() - 1.0);
+/**
+ * Packs the Statistic into a buffer of doubles, the moments followed by the histogram
+ * @param buffer pointer to the buffer, with room for 5 doubles and the histogram
+ * @return 0 if successful, nonzero otherwise
+ */
+int Statistic::pack(double* buffer) {
+    buffer[0] = this->count;
+    buffer[1] = this->mean;
+    buffer[2] = this->m2;
+    buffer[3] = this->min_value;
+    buffer[4] = this->max_value;
+    std::copy(this->histogram.begin(), this->histogram.end(), buffer + 5);
+
+    // Return with no errors
+    return 0;
 }
 
 /**
- * Gets the number of samples that have been added to the Statistic
- * @return number of samples in the Statistic
+ * Unpacks the Statistic from a buffer of doubles written by pack
+ * @param buffer pointer to the buffer
+ * @return 0 if successful, nonzero otherwise
  */
-int Statistic::getNumSamples() {
-    return this->values.size();
-}
\ No newline at end of file
+int Statistic::unpack(double* buffer) {
+    this->count = buffer[0];
+    this->mean = buffer[1];
+    this->m2 = buffer[2];
+    this->min_value = buffer[3];
+    this->max_value = buffer[4];
+    std::copy(buffer + 5, buffer + 5 + this->histogram.size(), this->histogram.begin());
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Combines packed Statistics for MPI_Reduce, with the pairwise formulas for the moments and a sum of the histograms
+ * @param in pointer to the packed Statistics to combine into the others
+ * @param inout pointer to the packed Statistics that are combined with the others
+ * @param len number of packed Statistics
+ * @param type pointer to the datatype of one packed Statistic
+ */
+void Statistic::combine(void* in, void* inout, int* len, MPI_Datatype* type) {
+    int type_size;
+    MPI_Type_size(*type, &type_size);
+    int length = type_size / sizeof(double);
+
+    for (int e = 0; e < *len; e++) {
+        double* a = (double*) in + e * length;
+        double* b = (double*) inout + e * length;
+        double count = a[0] + b[0];
+        if (count > 0.0) {
+            double delta = b[1] - a[1];
+            b[1] = a[1] + delta * b[0] / count;
+            b[2] = a[2] + b[2] + delta * delta * a[0] * b[0] / count;
+        }
+        b[0] = count;
+        b[3] = std::min(a[3], b[3]);
+        b[4] = std::max(a[4], b[4]);
+        for (int k = 5; k < length; k++) {
+            b[k] += a[k];
+        }
+    }
+}
+
+/**
+ * Combines the Statistics of all the processes of a communicator into the Statistic of the root process with a single
+ * MPI_Reduce. All the processes must estimate the quantiles or none.
+ * @param root rank of the process that receives the combined Statistic
+ * @param comm communicator of the processes
+ * @return 0 if successful, nonzero otherwise
+ */
+int Statistic::reduce(int root, MPI_Comm comm) {
+    int length = this->getPackedSize();
+    std::vector<double> local(length);
+    std::vector<double> combined(length);
+    this->pack(local.data());
+
+    // Reduce the packed Statistics in rank order, so that the rounding of the result does not change between runs
+    MPI_Datatype type;
+    MPI_Type_contiguous(length, MPI_DOUBLE, &type);
+    MPI_Type_commit(&type);
+    MPI_Op op;
+    MPI_Op_create(&Statistic::combine, 0, &op);
+    MPI_Reduce(local.data(), combined.data(), 1, type, op, root, comm);
+    MPI_Op_free(&op);
+    MPI_Type_free(&type);
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == root) {
+        this->unpack(combined.data());
+    }
+
+    // Return with no errors
+    return 0;
+}
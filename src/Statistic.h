@@ -6,21 +6,41 @@
 #define CA_TRAFFIC_SIMULATION_STATISTIC_H
 
 #include <vector>
+#include <mpi.h>
 
 /**
  * Class for the statistics of a property of the simulation, like Vehicle travel time on the road. Has methods for
- * adding samples to the statistic, or getting mean and variance
+ * adding samples to the statistic, or getting mean and variance. The samples are not stored, the moments are updated
+ * with Welford's method and combined across processes with the pairwise formulas of Chan et al. Optionally, the
+ * quantiles are estimated with a histogram of fixed size with logarithmically spaced buckets, so that the quantiles
+ * have a bounded relative error.
  */
 class Statistic {
 private:
-    std::vector<double> values;
+    double count;
+    double mean;
+    double m2;
+    double min_value;
+    double max_value;
+    std::vector<double> histogram;
+    static void combine(void* in, void* inout, int* len, MPI_Datatype* type);
 public:
-    Statistic();
+    static constexpr double SKETCH_MIN = 1.0e-3;
+    static constexpr double SKETCH_GROWTH = 1.01;
+    static constexpr int SKETCH_BUCKETS = 2800;
+
+    Statistic(bool track_quantiles = false);
     ~Statistic();
     void addValue(double value);
     double getAverage();
     double getVariance();
     int getNumSamples();
+    bool hasQuantiles();
+    double getQuantile(double q);
+    int getPackedSize();
+    int pack(double* buffer);
+    int unpack(double* buffer);
+    int reduce(int root, MPI_Comm comm);
 };
 
 
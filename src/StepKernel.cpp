@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include "StepKernel.h"
+
+/**
+ * Constructor for the StepKernel, selects the gap updates specialized for the inputs if there are any, and the generic
+ * gap updates otherwise
+ * @param inputs instance of the Inputs class with simulation inputs
+ */
+StepKernel::StepKernel(Inputs inputs) {
+    this->specialized = this->select<5, 2, 5>(inputs) || this->select<5, 3, 5>(inputs) ||
+        this->select<10, 2, 5>(inputs) || this->select<10, 3, 5>(inputs) || this->select<10, 2, 10>(inputs) ||
+        this->select<10, 3, 10>(inputs);
+    if (!this->specialized) {
+        this->update_gaps = &GapUpdate<StepKernel::ANY, StepKernel::ANY, StepKernel::ANY>::updateGaps;
+        this->update_forward_gap = &GapUpdate<StepKernel::ANY, StepKernel::ANY, StepKernel::ANY>::updateForwardGap;
+    }
+#ifdef DEBUG
+    std::cout << "using " << (this->specialized ? "specialized" : "generic") << " gap updates" << std::endl;
+#endif
+}
+
+/**
+ * Selects the gap updates of a specialization if its parameters match the inputs
+ * @tparam MAX_SPEED maximum speed of the specialization
+ * @tparam NUM_LANES number of Lanes of the specialization
+ * @tparam LOOK_BACK look backward distance of the specialization
+ * @param inputs instance of the Inputs class with simulation inputs
+ * @return whether or not the specialization was selected
+ */
+template <int MAX_SPEED, int NUM_LANES, int LOOK_BACK>
+bool StepKernel::select(const Inputs& inputs) {
+    if (inputs.max_speed != MAX_SPEED || inputs.num_lanes != NUM_LANES || inputs.look_other_backward != LOOK_BACK) {
+        return false;
+    }
+    this->update_gaps = &GapUpdate<MAX_SPEED, NUM_LANES, LOOK_BACK>::updateGaps;
+    this->update_forward_gap = &GapUpdate<MAX_SPEED, NUM_LANES, LOOK_BACK>::updateForwardGap;
+    return true;
+}
+
+/**
+ * Getter method for whether or not the gap updates are specialized for the inputs
+ * @return whether or not the gap updates are specialized
+ */
+bool StepKernel::isSpecialized() {
+    return this->specialized;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_STEPKERNEL_H
+#define CA_TRAFFIC_SIMULATION_STEPKERNEL_H
+
+#include "Inputs.h"
+#include "Road.h"
+#include "Lane.h"
+#include "VehicleStore.h"
+
+/**
+ * Class for the gap updates of the step, selected once for the inputs of the simulation. The common combinations of
+ * the maximum speed, the number of Lanes and the look backward distance have gap updates specialized at compile time,
+ * whose searches have a fixed reach and are unrolled, and every other combination uses the generic gap updates that
+ * read the parameters from the VehicleStore.
+ */
+class StepKernel {
+private:
+    bool specialized;
+    template <int MAX_SPEED, int NUM_LANES, int LOOK_BACK> bool select(const Inputs& inputs);
+public:
+    /**
+     * Value of a parameter of the gap updates that is not fixed at compile time
+     */
+    static constexpr int ANY = -1;
+
+    int (*update_gaps)(VehicleStore* store_ptr, int slot, Road* road_ptr);
+    int (*update_forward_gap)(VehicleStore* store_ptr, int slot, Road* road_ptr);
+
+    StepKernel(Inputs inputs);
+    bool isSpecialized();
+};
+
+/**
+ * Class template for the gap updates of a Vehicle with the maximum speed, the number of Lanes and the look backward
+ * distance fixed at compile time, or read from the VehicleStore for a parameter that is StepKernel::ANY. The reach of
+ * every search follows from the parameters, so the searches of a specialization cover a fixed range of sites.
+ * @tparam MAX_SPEED maximum speed of the Vehicles, less than 62
+ * @tparam NUM_LANES number of Lanes of the Road
+ * @tparam LOOK_BACK look backward distance into the other Lanes, less than 63
+ */
+template <int MAX_SPEED, int NUM_LANES, int LOOK_BACK>
+class GapUpdate {
+private:
+    static constexpr int FORWARD_REACH = (MAX_SPEED == StepKernel::ANY) ? StepKernel::ANY : MAX_SPEED;
+    static constexpr int OTHER_FORWARD_REACH = (MAX_SPEED == StepKernel::ANY) ? StepKernel::ANY : MAX_SPEED + 2;
+    static constexpr int OTHER_BACKWARD_REACH = (LOOK_BACK == StepKernel::ANY) ? StepKernel::ANY : LOOK_BACK + 1;
+
+    /**
+     * Locates the first occupied site at or after a site, with the reach fixed at compile time unless it is
+     * StepKernel::ANY
+     * @tparam REACH the number of sites after the first site to check, or StepKernel::ANY
+     * @param lane_ptr pointer to the Lane to search
+     * @param site the first site to check
+     * @param reach the number of sites after the first site to check, used when REACH is StepKernel::ANY
+     * @return the first occupied site, or site + reach + 1 if there is none
+     */
+    template <int REACH>
+    static inline int nextOccupied(Lane* lane_ptr, int site, int reach) {
+        if constexpr (REACH == StepKernel::ANY) {
+            return lane_ptr->nextOccupied(site, reach);
+        } else {
+            return lane_ptr->nextOccupiedWithin<REACH>(site);
+        }
+    }
+
+    /**
+     * Locates the last occupied site at or before a site, with the reach fixed at compile time unless it is
+     * StepKernel::ANY
+     * @tparam REACH the number of sites before the first site to check, or StepKernel::ANY
+     * @param lane_ptr pointer to the Lane to search
+     * @param site the first site to check
+     * @param reach the number of sites before the first site to check, used when REACH is StepKernel::ANY
+     * @return the last occupied site, or site - reach - 1 if there is none
+     */
+    template <int REACH>
+    static inline int prevOccupied(Lane* lane_ptr, int site, int reach) {
+        if constexpr (REACH == StepKernel::ANY) {
+            return lane_ptr->prevOccupied(site, reach);
+        } else {
+            return lane_ptr->prevOccupiedWithin<REACH>(site);
+        }
+    }
+
+public:
+    /**
+     * Update the perceived gaps between a Vehicle and the surrounding Vehicles in the Road, in its own Lane and in the
+     * Lanes below and above it. The gaps in a Lane that does not exist are set to -1, so that the Vehicle never
+     * changes to it.
+     * @param s pointer to the VehicleStore with the state of the Vehicle
+     * @param n slot of the Vehicle in the VehicleStore
+     * @param road_ptr pointer to the Road that the Vehicle is in
+     * @return 0 if successful, nonzero otherwise
+     */
+    static int updateGaps(VehicleStore* s, int n, Road* road_ptr) {
+        int position = s->position[n];
+        int num_lanes = (NUM_LANES == StepKernel::ANY) ? s->num_lanes : NUM_LANES;
+
+        // Locate the preceding Vehicle and update the forward gap. The gap is only ever compared against the speed
+        // plus one, so the search stops there and a larger gap is reported as max_speed + 1
+        Lane* lane_ptr = road_ptr->getLane(s->lane[n]);
+        s->gap_forward[n] = nextOccupied<FORWARD_REACH>(lane_ptr, position + 1, s->max_speed) - position - 1;
+
+        for (int side = 0; side < 2; side++) {
+            int other_lane = s->lane[n] + ((side == 0) ? -1 : 1);
+            if (other_lane < 0 || other_lane >= num_lanes) {
+                s->gap_other_forward[side][n] = -1;
+                s->gap_other_backward[side][n] = -1;
+                continue;
+            }
+            Lane* other_lane_ptr = road_ptr->getLane(other_lane);
+
+            // Update the forward gap in the other lane, which must exceed the look forward distance to switch Lanes
+            s->gap_other_forward[side][n] =
+                nextOccupied<OTHER_FORWARD_REACH>(other_lane_ptr, position, s->max_speed + 2) - position - 1;
+
+            // Update the backward gap in the other lane, which must exceed the look backward distance to switch Lanes
+            s->gap_other_backward[side][n] =
+                position - prevOccupied<OTHER_BACKWARD_REACH>(other_lane_ptr, position, s->look_other_backward + 1) - 1;
+        }
+
+        // Return with zero errors
+        return 0;
+    }
+
+    /**
+     * Update only the forward gap between a Vehicle and the preceding Vehicle in its Lane, which is all the lane move
+     * step needs
+     * @param s pointer to the VehicleStore with the state of the Vehicle
+     * @param n slot of the Vehicle in the VehicleStore
+     * @param road_ptr pointer to the Road that the Vehicle is in
+     * @return 0 if successful, nonzero otherwise
+     */
+    static int updateForwardGap(VehicleStore* s, int n, Road* road_ptr) {
+        int position = s->position[n];
+        Lane* lane_ptr = road_ptr->getLane(s->lane[n]);
+        s->gap_forward[n] = nextOccupied<FORWARD_REACH>(lane_ptr, position + 1, s->max_speed) - position - 1;
+
+        // Return with zero errors
+        return 0;
+    }
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_STEPKERNEL_H
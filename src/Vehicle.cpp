@@ -9,136 +9,130 @@
 #include "Vehicle.h"
 #include "Lane.h"
 #include "Road.h"
+#include "StepKernel.h"
+#include "Detectors.h"
 
 /**
- * Constructor for the Vehicle
- * @param lane_ptr pointer to the Lane in which the Vehicle starts in
- * @param id unique ID number of the Vehicle
- * @param initial_position initial site number of the Vehicle in the Lane
- * @param inputs instance of the Inputs class with the simulation inputs
+ * Constructor for the Vehicle, binds the handle to a slot in the VehicleStore. Vehicles are created by the VehiclePool,
+ * which acquires and releases the slots.
+ * @param store_ptr pointer to the VehicleStore that holds the state of the Vehicle
+ * @param slot slot of the Vehicle in the VehicleStore
  */
-Vehicle::Vehicle(Lane* lane_ptr, int id, int initial_position, Inputs inputs) {
-    // Set the ID number of the Vehicle
-    this->id = id;
-
-    // Set the initial position of the Vehicle
-    this->position = initial_position;
-
-    // Set the Lane pointer to the pointer to the Lane that contains the Vehicle
-    this->lane_ptr = lane_ptr;
-
-    // Set the maximum speed of the Vehicle
-    this->max_speed = inputs.max_speed;
-
-    // Set the initial speed of the Vehicle to the maximum speed
-    this->speed = this->max_speed;
-
-    // Set the look forward distance of the Vehicle
-    this->look_forward = this->speed + 1;
-
-    // Set the other lane look forward distance of the Vehicle
-    this->look_other_forward = this->look_forward;
-
-    // Set the other lane look backward distance of the Vehicle
-    this->look_other_backward = inputs.look_other_backward;
-
-    // Set the slow down probability of the Vehicle
-    this->prob_slow_down = inputs.prob_slow_down;
-
-    // Set the lane change probability of the Vehicle
-    this->prob_change = inputs.prob_change;
-
-    // Initialize the time spend on the Road
-    this->time_on_road = 0;
-
-    this->new_position;
+Vehicle::Vehicle(VehicleStore* store_ptr, int slot) {
+    this->store_ptr = store_ptr;
+    this->slot = slot;
 }
 
-Vehicle::~Vehicle() {}
+/**
+ * Getter method for the slot of the Vehicle in the VehicleStore
+ * @return slot of the Vehicle
+ */
+int Vehicle::getSlot() {
+    return this->slot;
+}
 
 /**
- * Update the perceived gaps between the Vehicle and the surrounding Vehicles in the Road
+ * Update the perceived gaps between the Vehicle and the surrounding Vehicles in the Road, in its own Lane and in the
+ * Lanes below and above it, with the gap updates that the StepKernel of the Road selected for the inputs. The gaps in a
+ * Lane that does not exist are set to -1, so that the Vehicle never changes to it.
  * @param road_ptr pointer to the Road that the Vehicle is in
  * @return 0 if successful, nonzero otherwise
-
  */
 int Vehicle::updateGaps(Road* road_ptr) {
-    // Locate the preceding Vehicle and update the forward gap
-    this->gap_forward = this->lane_ptr->getSize() - 1;
-    for (int i = this->position + 1; i < this->lane_ptr->getSize(); i++) {
-        if (this->lane_ptr->hasVehicleInSite(i)) {
-            this->gap_forward = i - this->position - 1;
-            break;
-        }
-    }
-
-    // Update vehicle look forward distances
-    this->look_forward = this->speed + 1;
-    this->look_other_forward = this->look_forward;
+    return road_ptr->getStepKernel()->update_gaps(this->store_ptr, this->slot, road_ptr);
+}
 
-    // Determine the other lane of interest
-    Lane* other_lane_ptr;
-    if (this->lane_ptr->getLaneNumber() == 0) {
-        other_lane_ptr = road_ptr->getLanes()[1];
-    } else {
-        other_lane_ptr = road_ptr->getLanes()[0];
-    }
+/**
+ * Update only the forward gap between the Vehicle and the preceding Vehicle in its Lane, which is all the lane move
+ * step needs
+ * @param road_ptr pointer to the Road that the Vehicle is in
+ * @return 0 if successful, nonzero otherwise
+ */
+int Vehicle::updateForwardGap(Road* road_ptr) {
+    return road_ptr->getStepKernel()->update_forward_gap(this->store_ptr, this->slot, road_ptr);
+}
 
-    // Update the forward gap in the other lane
-    this->gap_other_forward = this->lane_ptr->getSize() - 1;
-    for (int i = this->position; i < this->lane_ptr->getSize(); i++) {
-        if (other_lane_ptr->hasVehicleInSite(i)) {
-            this->gap_other_forward = i - this->position - 1;
-            break;
+/**
+ * Evaluates if the Vehicle will change lanes based on its gaps, without changing lanes yet. When both neighboring Lanes
+ * are open, the Vehicle changes to the one with the larger forward gap, and on a tie the random number that decided on
+ * the lane change also picks the Lane.
+ * @param road_ptr pointer to the Road in which the Vehicle is on
+ * @return whether or not the Vehicle will change lanes
+ */
+bool Vehicle::decideLaneSwitch(Road* road_ptr) {
+    VehicleStore* s = this->store_ptr;
+    int n = this->slot;
+    double prob_change = s->classes[s->vehicle_class[n]].prob_change;
+
+    // The look forward distances of the Vehicle follow from its speed
+    int look_forward = s->speed[n] + 1;
+    int look_other_forward = look_forward;
+
+    // Evaluate if the Vehicle will change lanes, and to which side
+    s->switching[n] = 0;
+    if (s->gap_forward[n] < look_forward) {
+        bool open[2];
+        for (int side = 0; side < 2; side++) {
+            open[side] = s->gap_other_forward[side][n] > look_other_forward &&
+                s->gap_other_backward[side][n] > s->look_other_backward;
         }
-    }
-
-    // Update the backward gap in the other lane
-    this->gap_other_backward = this->lane_ptr->getSize() - 1;
-    for (int i = this->position; i >= 0; i--) {
-        if (other_lane_ptr->hasVehicleInSite(i)) {
-            this->gap_other_backward = this->position - i - 1;
-            break;
+        if (open[0] || open[1]) {
+            double uniform = road_ptr->getRandom()->uniform(Random::LANE_SWITCH, s->id[n]);
+            if (uniform <= prob_change) {
+                int side = open[0] ? 0 : 1;
+                if (open[0] && open[1]) {
+                    int gap_lower = s->gap_other_forward[0][n];
+                    int gap_higher = s->gap_other_forward[1][n];
+                    if (gap_lower != gap_higher) {
+                        side = (gap_higher > gap_lower) ? 1 : 0;
+                    } else {
+                        side = (uniform < 0.5 * prob_change) ? 0 : 1;
+                    }
+                }
+                s->switching[n] = (side == 0) ? LOWER : HIGHER;
+            }
         }
     }
 
-    // Return with zero errors
-    return 0;
+    return s->switching[n] != 0;
 }
 
 /**
- * Moved the Vehicle to the other Lane in the Road
+ * Moves the Vehicle to the neighboring Lane if it decided to change lanes in the given direction. When the Vehicles
+ * change lanes together, two Vehicles can decide to change into the same site from the Lanes on both sides of it, so
+ * the Vehicle stays in its Lane if the site has been taken when it changes lanes.
  * @param road_ptr pointer to the Road in which the Vehicle is on
+ * @param direction the direction of the lane changes that are made
  * @return 0 if successful, nonzero otherwise
  */
-int Vehicle::performLaneSwitch(Road* road_ptr) {
-    // Evaluate if the Vehicle will change lanes and then perform the lane change
-    if (this->gap_forward < this->look_forward &&
-        this->gap_other_forward > this->look_other_forward &&
-        this->gap_other_backward > this->look_other_backward &&
-        ((double) rand()) / ((double) RAND_MAX) <= this->prob_change ) {
+int Vehicle::applyLaneSwitch(Road* road_ptr, int direction) {
+    VehicleStore* s = this->store_ptr;
+    int n = this->slot;
 
+    if (s->switching[n] != 0 && s->switching[n] == direction) {
         // Determine the lane that the Vehicle is switching to
-        Lane* other_lane_ptr;
-        if (this->lane_ptr->getLaneNumber() == 0) {
-            other_lane_ptr = road_ptr->getLanes()[1];
-        } else {
-            other_lane_ptr = road_ptr->getLanes()[0];
+        int other_lane = s->lane[n] + direction;
+        Lane* other_lane_ptr = road_ptr->getLane(other_lane);
+        s->switching[n] = 0;
+        if (other_lane_ptr->hasVehicleInSite(s->position[n])) {
+#ifdef DEBUG
+            std::cout << "vehicle " << s->id[n] << " yielded lane " << other_lane << std::endl;
+#endif
+            return 0;
         }
 
 #ifdef DEBUG
-        std::cout << "vehicle " << this->id << " switched lane " << this->lane_ptr->getLaneNumber() << " -> "
-            << other_lane_ptr->getLaneNumber() << std::endl;
+        std::cout << "vehicle " << s->id[n] << " switched lane " << s->lane[n] << " -> " << other_lane << std::endl;
 #endif
 
-        // Copy the Vehicle pointer to the other Lane
-        other_lane_ptr->addVehicle(this->position, this);
+        // Occupy the site in the other Lane
+        other_lane_ptr->addVehicle(s->position[n]);
 
-        // Remove the Vehicle pointer from the current Lane
-        this->lane_ptr->removeVehicle(this->position);
+        // Free the site in the current Lane
+        road_ptr->getLane(s->lane[n])->removeVehicle(s->position[n]);
 
-        // Set the pointer to the Lane in the Vehicle to the new lane
-        this->lane_ptr = other_lane_ptr;
+        // Set the Lane of the Vehicle to the new lane
+        s->lane[n] = other_lane;
     }
 
     // Return with zero errors
@@ -146,109 +140,163 @@ int Vehicle::performLaneSwitch(Road* road_ptr) {
 }
 
 /**
- * Moves the Vehicle to the next site in the current Lane during the time-step based on the speed of the Vehicle
+ * Moved the Vehicle to a neighboring Lane in the Road
+ * @param road_ptr pointer to the Road in which the Vehicle is on
  * @return 0 if successful, nonzero otherwise
  */
-int Vehicle::performLaneMove() {
+int Vehicle::performLaneSwitch(Road* road_ptr) {
+    // Evaluate if the Vehicle will change lanes and then perform the lane change
+    this->decideLaneSwitch(road_ptr);
+    return this->applyLaneSwitch(road_ptr, this->store_ptr->switching[this->slot]);
+}
+
+/**
+ * Updates the speed of the Vehicle for the time-step based on the vehicle speed update rules, without moving it yet
+ * @param road_ptr pointer to the Road in which the Vehicle is on
+ * @return 0 if successful, nonzero otherwise
+ */
+int Vehicle::updateSpeed(Road* road_ptr) {
+    VehicleStore* s = this->store_ptr;
+    int n = this->slot;
+    const VehicleClass& vehicle_class = s->classes[s->vehicle_class[n]];
+
     // Increment the time on road counter
-    this->time_on_road++;
+    s->time_on_road[n]++;
 
-    // Update Vehicle speed based on vehicle speed update rules
-    if (this->speed != this->max_speed) {
-        this->speed++;
+    // Update Vehicle speed based on vehicle speed update rules, up to the maximum speed of the class of the Vehicle
+    if (s->speed[n] < vehicle_class.max_speed) {
+        s->speed[n]++;
 #ifdef DEBUG
-        std::cout << "vehicle " << this->id << " increased speed " << this->speed - 1 << " -> " << this->speed
+        std::cout << "vehicle " << s->id[n] << " increased speed " << s->speed[n] - 1 << " -> " << s->speed[n]
             << std::endl;
 #endif
     }
 
-    this->speed = std::min(this->speed, this->gap_forward);
+    s->speed[n] = std::min(s->speed[n], s->gap_forward[n]);
 #ifdef DEBUG
-    if (this->speed == 0) {
-        std::cout << "vehicle " << this->id << " stopped behind preceding vehicle" << std::endl;
+    if (s->speed[n] == 0) {
+        std::cout << "vehicle " << s->id[n] << " stopped behind preceding vehicle" << std::endl;
     }
 #endif
 
-    if (this->speed > 0) {
-        if ( ((double) rand()) / ((double) RAND_MAX) <= this->prob_slow_down ) {
-            this->speed--;
+    if (s->speed[n] > 0) {
+        if (road_ptr->getRandom()->uniform(Random::SLOW_DOWN, s->id[n]) <= vehicle_class.prob_slow_down) {
+            s->speed[n]--;
 #ifdef DEBUG
-            std::cout << "vehicle " << this->id << " decreased speed " << this->speed + 1 << " -> " << this->speed
+            std::cout << "vehicle " << s->id[n] << " decreased speed " << s->speed[n] + 1 << " -> " << s->speed[n]
                 << std::endl;
 #endif
         }
     }
 
-    if (this->speed > 0) {
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Moves the Vehicle to the next site in the current Lane based on its updated speed
+ * @param road_ptr pointer to the Road in which the Vehicle is on
+ * @return 0 if the Vehicle is still in the Lane, otherwise the time on road of the Vehicle that reached the exit site
+ */
+int Vehicle::applyLaneMove(Road* road_ptr) {
+    VehicleStore* s = this->store_ptr;
+    int n = this->slot;
+    Lane* lane_ptr = road_ptr->getLane(s->lane[n]);
+
+    if (s->speed[n] > 0) {
         // Compute the new position of the vehicle
-        int new_position = (this->position + this->speed) % this->lane_ptr->getSize();
+        int new_position = s->position[n] + s->speed[n];
+
+        // Count the Vehicle at the detectors that it crosses
+        Detectors* detectors_ptr = road_ptr->getDetectors();
+        if (detectors_ptr != nullptr) {
+            detectors_ptr->recordMove(s->position[n], new_position, s->speed[n]);
+        }
 
-        // If the vehicle reached the end of the road, remove the Vehicle from the Lane and return the time on road
-        if (this->position > new_position) {
+        // If the vehicle reached the exit site of the Lane, remove it from the Lane and return its time on road
+        if (new_position >= lane_ptr->getExitSite()) {
 #ifdef DEBUG
-            std::cout << "vehicle " << this->id << " spent " << this->time_on_road << " steps on the road" << std::endl;
+            std::cout << "vehicle " << s->id[n] << " left the segment after " << s->time_on_road[n] << " steps"
+                << std::endl;
 #endif
-            this->new_position = new_position;
+            // Store the position relative to the start of the next segment
+            s->new_position[n] = new_position - lane_ptr->getSize();
 
-            // Remove vehicle from the Road
-            //this->lane_ptr->removeVehicle(this->position);
+            // Remove vehicle from the Lane
+            lane_ptr->removeVehicle(s->position[n]);
 
             // Return the time on the Road
-            return this->time_on_road;
+            return s->time_on_road[n];
         }
 
 #ifdef DEBUG
-        std::cout << "vehicle " << this->id << " moved " << this->position << " -> " << new_position << std::endl;
+        std::cout << "vehicle " << s->id[n] << " moved " << s->position[n] << " -> " << new_position << std::endl;
 #endif
 
-        // Update Vehicle position in the Lane object sites
-        this->lane_ptr->addVehicle(new_position, this);
-
-        // Remove vehicle from the old site
-        this->lane_ptr->removeVehicle(this->position);
+        // Move the Vehicle to the new site in the Lane
+        lane_ptr->moveVehicle(s->position[n], new_position);
 
         // Update the Vehicle position value
-        this->position = new_position;
+        s->position[n] = new_position;
     }
+    s->new_position[n] = s->position[n];
 
     // Return with no errors
     return 0;
 }
 
+/**
+ * Moves the Vehicle to the next site in the current Lane during the time-step based on the speed of the Vehicle
+ * @param road_ptr pointer to the Road in which the Vehicle is on
+ * @return 0 if the Vehicle is still in the Lane, otherwise the time on road of the Vehicle that left the Lane
+ */
+int Vehicle::performLaneMove(Road* road_ptr) {
+    this->updateSpeed(road_ptr);
+    return this->applyLaneMove(road_ptr);
+}
+
 /**
  * Getter method for the ID number of the Vehicle
  * @return
  */
 int Vehicle::getId() {
-    return this->id;
+    return this->store_ptr->id[this->slot];
 }
 
 int Vehicle::getSpeed(){
-    return this->speed;
+    return this->store_ptr->speed[this->slot];
 }
 
 int Vehicle::getVehicleLane() {
-    return this->lane_ptr->getLaneNumber();
+    return this->store_ptr->lane[this->slot];
 }
 
 int Vehicle::getNewPosition() {
-    return this->new_position;
+    return this->store_ptr->new_position[this->slot];
 }
 
 int Vehicle::getTimeOnRoad(){
-    return this->time_on_road;
+    return this->store_ptr->time_on_road[this->slot];
 }
 
 int Vehicle::getPrevPosition(){
-    return this->position;
+    return this->store_ptr->position[this->slot];
+}
+
+/**
+ * Getter method for the class of the Vehicle, which indexes the table of classes of the VehicleStore
+ * @return the class of the Vehicle
+ */
+int Vehicle::getVehicleClass() {
+    return this->store_ptr->vehicle_class[this->slot];
 }
 /**
  * Getter method for the total time the Vehicle has spent on the Road
  * @param inputs
  * @return
  */
-double Vehicle::getTravelTime(Inputs inputs) {
-    return inputs.step_size * this->time_on_road;
+double Vehicle::getTravelTime(const Inputs& inputs) {
+    return inputs.step_size * this->store_ptr->time_on_road[this->slot];
 }
 
 /**
@@ -257,38 +305,42 @@ double Vehicle::getTravelTime(Inputs inputs) {
  * @return
  */
 int Vehicle::setSpeed(int speed) {
-    this->speed = speed;
+    this->store_ptr->speed[this->slot] = speed;
 
     // Return with no errors
     return 0;
 }
 
 int Vehicle::setTimeOnRoad(int time_on_road) {
-    this->time_on_road = time_on_road;
+    this->store_ptr->time_on_road[this->slot] = time_on_road;
 
     // Return with no errors
     return 0;
 }
 
-
-int Vehicle::setTempPosition(int position) {
-    this->position = position;
+/**
+ * Setter method for the position of the Vehicle, for moving it to another coordinate of the segment without updating
+ * the Lane
+ * @param position new position of the Vehicle
+ * @return 0 if successful, nonzero otherwise
+ */
+int Vehicle::setPosition(int position) {
+    this->store_ptr->position[this->slot] = position;
+    this->store_ptr->new_position[this->slot] = position;
 
     // Return with no errors
     return 0;
 }
 
-Lane* Vehicle::getLane() const {
-    return this->lane_ptr;
-}
-
 
 /**
  * Debug method for printing the gap information of the Vehicle
  */
 #ifdef DEBUG
 void Vehicle::printGaps() {
-    std::cout << "vehicle " << std::setw(2) << this->id << " gaps, >:" << this->gap_forward << " ^>:"
-        << this->gap_other_forward << " ^<:" << this->gap_other_backward << std::endl;
+    VehicleStore* s = this->store_ptr;
+    std::cout << "vehicle " << std::setw(2) << s->id[this->slot] << " gaps, >:" << s->gap_forward[this->slot]
+        << " v>:" << s->gap_other_forward[0][this->slot] << " v<:" << s->gap_other_backward[0][this->slot]
+        << " ^>:" << s->gap_other_forward[1][this->slot] << " ^<:" << s->gap_other_backward[1][this->slot] << std::endl;
 }
-#endif
\ No newline at end of file
+#endif
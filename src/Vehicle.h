@@ -8,50 +8,51 @@
 #include "Inputs.h"
 #include "Road.h"
 #include "Statistic.h"
+#include "VehicleStore.h"
 
 // Forward declarations
 class Lane;
 
 /**
- * Constructor for a Vehicle in the simulation. Has methods for performing movements based on the CA rules of the
+ * Class for a Vehicle in the simulation. The Vehicle is a lightweight handle to a slot in the VehicleStore of the Road,
+ * recycled by the VehiclePool of the Road, and has methods for performing movements based on the CA rules of the
  * simulation.
  */
 class Vehicle {
 private:
-    Lane* lane_ptr;
-    int id;
-    int position;
-    int speed;
-    int max_speed;
-    int gap_forward;
-    int gap_other_forward;
-    int gap_other_backward;
-    int look_forward;
-    int look_other_forward;
-    int look_other_backward;
-    double prob_slow_down;
-    double prob_change;
-    int time_on_road;
-    int new_position;
+    VehicleStore* store_ptr;
+    int slot;
 
 public:
-    Vehicle(Lane* lane_ptr, int id, int initial_position, Inputs inputs);
-    ~Vehicle();
+    /**
+     * Directions of a lane change, towards the Lane with the next lower or the next higher number
+     */
+    enum Direction {
+        LOWER = -1,
+        HIGHER = 1
+    };
+
+    Vehicle(VehicleStore* store_ptr, int slot);
+    int getSlot();
     int updateGaps(Road* road_ptr);
+    int updateForwardGap(Road* road_ptr);
+    bool decideLaneSwitch(Road* road_ptr);
+    int applyLaneSwitch(Road* road_ptr, int direction);
     int performLaneSwitch(Road* road_ptr);
-    int performLaneMove();
+    int updateSpeed(Road* road_ptr);
+    int applyLaneMove(Road* road_ptr);
+    int performLaneMove(Road* road_ptr);
     int getId();
-    double getTravelTime(Inputs inputs);
+    double getTravelTime(const Inputs& inputs);
     int setSpeed(int speed);
     int getSpeed();
     int setTimeOnRoad(int time_on_road);
+    int setPosition(int position);
     int getVehicleLane();
     int getNewPosition();
     int getTimeOnRoad();
     int getPrevPosition();
-    int setTempPosition(int position);
-    Lane* setLane(Lane* lane_ptr);
-    Lane* getLane() const;
+    int getVehicleClass();
 
 #ifdef DEBUG
     void printGaps();
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include "VehiclePool.h"
+#include "Vehicle.h"
+
+/**
+ * Constructor for the VehiclePool
+ * @param store_ptr pointer to the VehicleStore that holds the state of the Vehicles
+ */
+VehiclePool::VehiclePool(VehicleStore* store_ptr) {
+    this->store_ptr = store_ptr;
+}
+
+/**
+ * Destructor for the VehiclePool, deletes all the Vehicle handles whether or not they are in use
+ */
+VehiclePool::~VehiclePool() {
+    for (int i = 0; i < (int) this->handles.size(); i++) {
+        delete this->handles[i];
+    }
+}
+
+/**
+ * Acquires a Vehicle from the pool, reusing the handle of a released slot if there is one. The Vehicle starts at the
+ * maximum speed of its class.
+ * @param lane number of the Lane that the Vehicle starts in
+ * @param id unique ID number of the Vehicle
+ * @param position initial site number of the Vehicle in the Lane
+ * @param vehicle_class class of the Vehicle
+ * @return pointer to the Vehicle
+ */
+Vehicle* VehiclePool::acquire(int lane, int id, int position, int vehicle_class) {
+    int slot = this->store_ptr->acquire(lane, id, position, vehicle_class);
+    if (slot == (int) this->handles.size()) {
+        this->handles.push_back(new Vehicle(this->store_ptr, slot));
+    }
+    return this->handles[slot];
+}
+
+/**
+ * Releases a Vehicle back to the pool, the Vehicle must not be used afterwards
+ * @param vehicle_ptr pointer to the Vehicle
+ * @return 0 if successful, nonzero otherwise
+ */
+int VehiclePool::release(Vehicle* vehicle_ptr) {
+    this->store_ptr->release(vehicle_ptr->getSlot());
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the VehicleStore that holds the state of the Vehicles of the pool
+ * @return pointer to the VehicleStore
+ */
+VehicleStore* VehiclePool::getVehicleStore() {
+    return this->store_ptr;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_VEHICLEPOOL_H
+#define CA_TRAFFIC_SIMULATION_VEHICLEPOOL_H
+
+#include <vector>
+
+#include "VehicleStore.h"
+
+// Forward declarations
+class Vehicle;
+
+/**
+ * Class for the pool of Vehicles in a segment of the Road. Every slot of the VehicleStore has one Vehicle handle that
+ * is created the first time the slot is used and recycled with the slot afterwards, so spawning, arriving, leaving and
+ * migrating Vehicles do not allocate memory once the pool has grown to the number of Vehicles in the segment.
+ */
+class VehiclePool {
+private:
+    VehicleStore* store_ptr;
+    std::vector<Vehicle*> handles;
+public:
+    VehiclePool(VehicleStore* store_ptr);
+    ~VehiclePool();
+    Vehicle* acquire(int lane, int id, int position, int vehicle_class);
+    int release(Vehicle* vehicle_ptr);
+    VehicleStore* getVehicleStore();
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_VEHICLEPOOL_H
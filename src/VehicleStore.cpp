@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include "VehicleStore.h"
+
+/**
+ * Constructor for the VehicleStore
+ * @param inputs instance of the Inputs class with simulation inputs
+ */
+VehicleStore::VehicleStore(Inputs inputs) {
+    // Set the parameters that are shared by all the Vehicles
+    this->num_lanes = inputs.num_lanes;
+    this->max_speed = inputs.max_speed;
+    this->look_other_backward = inputs.look_other_backward;
+
+    // Set the table of the classes of the Vehicles, a single class with the parameters of the inputs by default, and
+    // the cumulative fractions of the classes for picking the class of a spawned Vehicle
+    this->classes = inputs.vehicle_classes;
+    if (this->classes.empty()) {
+        this->classes.push_back({1.0, inputs.max_speed, inputs.prob_slow_down, inputs.prob_change});
+    }
+    double cumulative = 0.0;
+    for (VehicleClass vehicle_class : this->classes) {
+        cumulative += vehicle_class.fraction;
+        this->class_cdf.push_back(cumulative);
+    }
+}
+
+/**
+ * Acquires a slot for a new Vehicle, reusing a released slot if there is one. The Vehicle starts at the maximum speed
+ * of its class.
+ * @param lane number of the Lane that the Vehicle starts in
+ * @param id unique ID number of the Vehicle
+ * @param position initial site number of the Vehicle in the Lane
+ * @param vehicle_class class of the Vehicle
+ * @return the slot of the Vehicle
+ */
+int VehicleStore::acquire(int lane, int id, int position, int vehicle_class) {
+    int slot;
+    if (!this->free_slots.empty()) {
+        slot = this->free_slots.back();
+        this->free_slots.pop_back();
+    } else {
+        slot = this->id.size();
+        this->id.push_back(0);
+        this->lane.push_back(0);
+        this->position.push_back(0);
+        this->new_position.push_back(0);
+        this->speed.push_back(0);
+        this->time_on_road.push_back(0);
+        this->gap_forward.push_back(0);
+        for (int side = 0; side < 2; side++) {
+            this->gap_other_forward[side].push_back(0);
+            this->gap_other_backward[side].push_back(0);
+        }
+        this->switching.push_back(0);
+        this->vehicle_class.push_back(0);
+    }
+
+    // Initialize the state of the Vehicle
+    this->id[slot] = id;
+    this->lane[slot] = lane;
+    this->position[slot] = position;
+    this->new_position[slot] = position;
+    this->vehicle_class[slot] = (unsigned char) vehicle_class;
+    this->speed[slot] = this->classes[vehicle_class].max_speed;
+    this->time_on_road[slot] = 0;
+    this->gap_forward[slot] = 0;
+    for (int side = 0; side < 2; side++) {
+        this->gap_other_forward[side][slot] = 0;
+        this->gap_other_backward[side][slot] = 0;
+    }
+    this->switching[slot] = 0;
+
+    return slot;
+}
+
+/**
+ * Picks the class of a spawned Vehicle from the fractions of the classes
+ * @param uniform uniformly distributed random number in [0, 1)
+ * @return the class of the Vehicle
+ */
+int VehicleStore::pickClass(double uniform) {
+    int vehicle_class = 0;
+    while (vehicle_class < (int) this->classes.size() - 1 && uniform >= this->class_cdf[vehicle_class]) {
+        vehicle_class++;
+    }
+    return vehicle_class;
+}
+
+/**
+ * Releases the slot of a Vehicle so that it can be reused
+ * @param slot the slot of the Vehicle
+ * @return 0 if successful, nonzero otherwise
+ */
+int VehicleStore::release(int slot) {
+    this->free_slots.push_back(slot);
+
+    // Return with no errors
+    return 0;
+}
+
+/**
+ * Getter for the number of Vehicles that currently hold a slot
+ * @return number of Vehicles in the VehicleStore
+ */
+int VehicleStore::getNumVehicles() {
+    return this->id.size() - this->free_slots.size();
+}
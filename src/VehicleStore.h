@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#ifndef CA_TRAFFIC_SIMULATION_VEHICLESTORE_H
+#define CA_TRAFFIC_SIMULATION_VEHICLESTORE_H
+
+#include <vector>
+
+#include "Inputs.h"
+
+/**
+ * Class for the state of all the Vehicles in a segment of the Road, stored as a structure of arrays indexed by slot.
+ * The gaps in the neighboring Lanes are stored for the Lane below and the Lane above the Vehicle, indexed by the side
+ * of the Vehicle, and the lane change that a Vehicle decided on is stored as the direction of the change. The
+ * parameters that are the same for every Vehicle are stored once, and the parameters of the classes of the Vehicles
+ * are stored in a table indexed by the one byte class of every Vehicle. Acts as a structure so that the update loops
+ * can stream over the arrays, and has methods to acquire and release slots.
+ */
+class VehicleStore {
+public:
+    std::vector<int> id;
+    std::vector<int> lane;
+    std::vector<int> position;
+    std::vector<int> new_position;
+    std::vector<int> speed;
+    std::vector<int> time_on_road;
+    std::vector<int> gap_forward;
+    std::vector<int> gap_other_forward[2];
+    std::vector<int> gap_other_backward[2];
+    std::vector<signed char> switching;
+    std::vector<unsigned char> vehicle_class;
+    std::vector<VehicleClass> classes;
+    int num_lanes;
+    int max_speed;
+    int look_other_backward;
+    VehicleStore(Inputs inputs);
+    int acquire(int lane, int id, int position, int vehicle_class);
+    int pickClass(double uniform);
+    int release(int slot);
+    int getNumVehicles();
+private:
+    std::vector<int> free_slots;
+    std::vector<double> class_cdf;
+};
+
+
+#endif //CA_TRAFFIC_SIMULATION_VEHICLESTORE_H
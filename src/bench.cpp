@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2019 Maitreya Venkataswamy - All Rights Reserved
+ */
+
+#include <iostream>
+
+#include "Inputs.h"
+#include "Benchmark.h"
+#include <mpi.h>
+
+/**
+ * Main point of execution of the benchmark suite, which takes the parameters of the Vehicles from the input file and
+ * runs the matrix of configurations given on the command line
+ * @param argc number of command line arguments
+ * @param argv command line arguments
+ * @return 0 if successful, nonzero otherwise
+ */
+int main(int argc, char** argv) {
+
+    // Only the main thread communicates, the threads of a process just update their blocks of the segment
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    // Create an Inputs object to contain the simulation parameters, which is read by the first process only
+    Inputs inputs = Inputs();
+    if (inputs.load("cats-input.txt", {}, MPI_COMM_WORLD) != 0) {
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Use a fixed seed, so that every run of the benchmark simulates the same Vehicles
+    inputs.seed = 1;
+
+    Benchmark benchmark(inputs);
+    int status = benchmark.parseArguments(argc, argv);
+    if (status == 0) {
+        status = benchmark.run();
+    }
+
+    MPI_Finalize();
+
+    return status;
+}
@@ -3,38 +3,105 @@
  */
 
 #include <iostream>
+#include <ctime>
+#include <vector>
+#include <string>
 
 #include "Inputs.h"
 #include "Simulation.h"
+#include "HaloExchange.h"
+#include "Ensemble.h"
+#include "Network.h"
 #include <mpi.h>
 
 /**
- * Main point of execution of the program
+ * Main point of execution of the program, which runs a single simulation or, with --ensemble and the path of an
+ * ensemble file, the replicas of the ensemble, or the links of a network when the inputs give a network file. The
+ * inputs are read from "cats-input.txt", or the file given with --input, and the inputs given on the command line as
+ * key=value override the ones in the file.
  * @param argc number of command line arguments
  * @param argv command line arguments
  * @return 0 if successful, nonzero otherwise
  */
 int main(int argc, char** argv) {
-    
-#ifndef DEBUG
-    srand(time(NULL));
-#endif
 
-    // Create an Inputs object to contain the simulation parameters
+    // Only the main thread communicates, the threads of a process just update their blocks of the segment
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank); // Get the rank of the process
+    MPI_Comm_size(MPI_COMM_WORLD, &size); // Get the total number of processes
+
+    if (provided < MPI_THREAD_FUNNELED && rank == 0) {
+        std::cerr << "warning: the MPI library does not support threads" << std::endl;
+    }
+
+    // Parse the command line
+    std::string input_path = "cats-input.txt";
+    std::string ensemble_path = "";
+    std::vector<std::string> overrides;
+    bool valid = true;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--input" && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (argument == "--ensemble" && i + 1 < argc) {
+            ensemble_path = argv[++i];
+        } else if (argument.find('=') != std::string::npos) {
+            overrides.push_back(argument);
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        if (rank == 0) {
+            std::cout << "usage: cats [--input input-file] [--ensemble ensemble-file] [key=value ...]" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Create an Inputs object to contain the simulation parameters, which is read by the first process only
     Inputs inputs = Inputs();
-    if (inputs.loadFromFile() != 0) {
+    if (inputs.load(input_path, overrides, MPI_COMM_WORLD) != 0) {
+        MPI_Finalize();
         return 1;
     }
 
-    MPI_Init(&argc, &argv);
+    // Seed the random number generator from the clock except in debug mode, using the same seed on every process so
+    // that the random numbers do not depend on the partitioning of the Road
+#ifdef DEBUG
+    inputs.seed = 1;
+#else
+    inputs.seed = time(NULL);
+#endif
+    MPI_Bcast(&(inputs.seed), 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
 
-    int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank); // Get the rank of the process
-    MPI_Comm_size(MPI_COMM_WORLD, &size); // Get the total number of processes
+    // Run the replicas of an ensemble on groups of the processes instead of a single simulation on all of them
+    if (!ensemble_path.empty()) {
+        Ensemble ensemble(inputs);
+        int status = ensemble.loadFromFile(ensemble_path);
+        if (status == 0) {
+            status = ensemble.run();
+        }
+        MPI_Finalize();
+        return status;
+    }
 
-    if (size < 2) { // check for processes number
-        std::cerr << "It takes at least 2 processes to run the program!" << std::endl;
-        MPI_Abort(MPI_COMM_WORLD, 1);
+    // Run the links of a network of roads on all the processes instead of a single road
+    if (!inputs.network_path.empty()) {
+        Network* network_ptr = new Network(inputs, MPI_COMM_WORLD);
+        int status = network_ptr->loadFromFile(inputs.network_path);
+        if (status == 0) {
+            status = network_ptr->run();
+        }
+        if (status == 0 && rank == 0) {
+            network_ptr->printResults();
+        }
+        delete network_ptr;
+        MPI_Finalize();
+        return status;
     }
 
     int road_length = inputs.length;
@@ -45,7 +112,15 @@ int main(int argc, char** argv) {
     int end_pos = start_pos + segment_size - 1;
     if (rank < remainder) end_pos++;
 
-    int road_length_per_process = end_pos - start_pos;
+    int road_length_per_process = end_pos - start_pos + 1;
+
+    // Vehicles only see into the neighboring segments, so every segment must be wider than the boundary region
+    if (segment_size < HaloExchange::minSegmentSize(inputs)) {
+        if (rank == 0) {
+            std::cerr << "The road is too short to be split between " << size << " processes!" << std::endl;
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
     if(rank ==0){
         std::cout << "================================================" << std::endl;
@@ -53,15 +128,29 @@ int main(int argc, char** argv) {
         std::cout << "================================================" << std::endl;
     }
 
+    // Arrange the segments along the Road in a Cartesian communicator, which joins the last segment to the first one
+    // when the Road is a ring
+    MPI_Comm road_comm;
+    int dims[1] = {size};
+    int periods[1] = {inputs.periodic};
+    MPI_Cart_create(MPI_COMM_WORLD, 1, dims, periods, 0, &road_comm);
+
     // Create a Simulation object for the current simulation
     Simulation* simulation_ptr = new Simulation(inputs, road_length_per_process);
 
     // Run the Simulation
-    simulation_ptr->run_simulation(rank, size, road_length_per_process);
+    simulation_ptr->run_simulation(road_comm);
+    if (rank == 0) {
+        simulation_ptr->printResults();
+    }
 
     // Delete the Simulation object
     delete simulation_ptr;
 
+    MPI_Comm_free(&road_comm);
+
+    MPI_Finalize();
+
     // Return with no errors
     return 0;
 }